@@ -4,17 +4,18 @@ namespace pywrap {
     AdaBoostPy::AdaBoostPy() : PyClassifier("sklearn.ensemble", "AdaBoostClassifier", true)
     {
         validHyperparameters = { "n_estimators", "n_jobs", "random_state" };
+        sparseInput = true;
     }
     int AdaBoostPy::getNumberOfEdges() const
     {
-        return callMethodSumOfItems("get_n_leaves");
+        return metadataInt("leaves");
     }
     int AdaBoostPy::getNumberOfStates() const
     {
-        return callMethodSumOfItems("get_depth");
+        return metadataInt("depth");
     }
     int AdaBoostPy::getNumberOfNodes() const
     {
-        return callMethodSumOfItems("node_count");
+        return metadataInt("nodes");
     }
 } /* namespace pywrap */
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include <algorithm>
+#include "Cancellation.h"
+#include "PyHelper.hpp"
+
+namespace pywrap {
+    namespace {
+        thread_local const CallLimits* currentLimits = nullptr;
+    }
+    void CancellationToken::cancel()
+    {
+        state->store(true);
+        Watchdog::instance().wake();
+    }
+    CallLimits::CallLimits(std::chrono::milliseconds timeout) : previous(currentLimits)
+    {
+        if (timeout.count() > 0) {
+            deadline = std::chrono::steady_clock::now() + timeout;
+        }
+        if (previous != nullptr) {
+            deadline = std::min(deadline, previous->deadline);
+        }
+        currentLimits = this;
+    }
+    CallLimits::CallLimits(const CancellationToken& token, std::chrono::milliseconds timeout) : CallLimits(timeout)
+    {
+        this->token = token;
+    }
+    CallLimits::~CallLimits()
+    {
+        currentLimits = previous;
+    }
+    const CallLimits* CallLimits::current()
+    {
+        return currentLimits;
+    }
+    StopReason CallLimits::stopReason(std::chrono::steady_clock::time_point now) const
+    {
+        for (auto limits = this; limits != nullptr; limits = limits->previous) {
+            if (limits->token && limits->token->cancelled()) {
+                return StopReason::Cancelled;
+            }
+        }
+        return now >= deadline ? StopReason::Deadline : StopReason::None;
+    }
+    Watchdog& Watchdog::instance()
+    {
+        // Never destroyed, its thread sleeps until the process ends
+        static Watchdog* watchdog = new Watchdog();
+        return *watchdog;
+    }
+    uint64_t Watchdog::watch(const CallLimits& limits, PyObject* exception)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!started) {
+            // A detached thread isn't joinable, the flag is what tells it is already running
+            std::thread(&Watchdog::run, this).detach();
+            started = true;
+            threads++;
+        }
+        auto ticket = nextTicket++;
+        entries[ticket] = { &limits, PyThread_get_thread_ident(), exception };
+        watched++;
+        changed.notify_all();
+        return ticket;
+    }
+    StopReason Watchdog::unwatch(uint64_t ticket)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto item = entries.find(ticket);
+        if (item == entries.end()) {
+            return StopReason::None;
+        }
+        auto entry = item->second;
+        entries.erase(item);
+        if (!entry.raised) {
+            return StopReason::None;
+        }
+        // Raised while the call was already on its way out, it must not hit what the thread runs next
+        PyThreadState_SetAsyncExc(entry.threadId, nullptr);
+        return entry.fired;
+    }
+    void Watchdog::wake()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+        }
+        changed.notify_all();
+    }
+    void Watchdog::run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            auto now = std::chrono::steady_clock::now();
+            auto next = std::chrono::steady_clock::time_point::max();
+            bool fire = false;
+            for (auto& [ticket, entry] : entries) {
+                if (entry.fired != StopReason::None) {
+                    continue;
+                }
+                entry.fired = entry.limits->stopReason(now);
+                if (entry.fired == StopReason::None) {
+                    next = std::min(next, entry.limits->getDeadline());
+                } else {
+                    fire = true;
+                }
+            }
+            if (fire) {
+                lock.unlock();
+                {
+                    // GIL first, then the lock. Entries are unwatched with the GIL held,
+                    // so every one still here belongs to a call that is running
+                    PyGILGuard gil;
+                    std::lock_guard<std::mutex> relock(mutex);
+                    for (auto& [ticket, entry] : entries) {
+                        if (entry.fired == StopReason::None || entry.raised) {
+                            continue;
+                        }
+                        PyThreadState_SetAsyncExc(entry.threadId, entry.exception);
+                        entry.raised = true;
+                        if (entry.fired == StopReason::Cancelled) {
+                            cancelled++;
+                        } else {
+                            expired++;
+                        }
+                    }
+                }
+                lock.lock();
+                continue;
+            }
+            if (next == std::chrono::steady_clock::time_point::max()) {
+                changed.wait(lock);
+            } else {
+                changed.wait_until(lock, next);
+            }
+        }
+    }
+    nlohmann::json Watchdog::stats()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return { { "threads", threads }, { "watched", watched }, { "running", entries.size() }, { "cancelled", cancelled }, { "deadline_exceeded", expired } };
+    }
+} /* namespace pywrap */
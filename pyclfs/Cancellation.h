@@ -0,0 +1,86 @@
+#ifndef CANCELLATION_H
+#define CANCELLATION_H
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <nlohmann/json.hpp>
+#include "boost/python/detail/wrap_python.hpp"
+
+namespace pywrap {
+    enum class StopReason { None, Cancelled, Deadline };
+    // Stops the calls running under it from any thread, copies share the same state
+    class CancellationToken {
+    public:
+        CancellationToken() : state(std::make_shared<std::atomic<bool>>(false)) {}
+        void cancel();
+        bool cancelled() const { return state->load(); }
+    private:
+        std::shared_ptr<std::atomic<bool>> state;
+    };
+    /*
+    Limits the PyWrap fit/predict/predict_proba/score calls the constructing thread makes while it
+    lives. Nested limits add up: the earliest deadline and every token apply. A zero timeout is no deadline.
+        pywrap::CancellationToken token;
+        pywrap::CallLimits limits(token, std::chrono::minutes(10));
+        clf.fit(X, y); // PyDeadlineException after 10 minutes, PyCancelledException on token.cancel()
+    */
+    class CallLimits {
+    public:
+        explicit CallLimits(std::chrono::milliseconds timeout);
+        explicit CallLimits(const CancellationToken& token, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero());
+        ~CallLimits();
+        CallLimits(const CallLimits&) = delete;
+        CallLimits& operator=(const CallLimits&) = delete;
+        // Innermost limits of the calling thread, nullptr without any
+        static const CallLimits* current();
+        StopReason stopReason(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) const;
+        std::chrono::steady_clock::time_point getDeadline() const { return deadline; }
+    private:
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+        std::optional<CancellationToken> token;
+        const CallLimits* previous;
+    };
+    /*
+    Thread stopping the watched Python calls whose limits ran out, by raising an exception in the
+    thread running them (PyThreadState_SetAsyncExc). The exception shows up at the next bytecode
+    the call runs: native code is only stopped once it gets back to the interpreter.
+    */
+    class Watchdog {
+    public:
+        static Watchdog& instance();
+        Watchdog(const Watchdog&) = delete;
+        Watchdog& operator=(const Watchdog&) = delete;
+        // Watches the call the calling thread is about to make, exception is the type raised in it (GIL held)
+        uint64_t watch(const CallLimits& limits, PyObject* exception);
+        // Why the watch fired, None if it didn't. An exception still pending is discarded (GIL held)
+        StopReason unwatch(uint64_t ticket);
+        // Limits changed, a token was cancelled
+        void wake();
+        nlohmann::json stats();
+    private:
+        Watchdog() = default;
+        void run();
+        struct Entry {
+            const CallLimits* limits;
+            unsigned long threadId;
+            PyObject* exception;
+            StopReason fired = StopReason::None;
+            bool raised = false;
+        };
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::map<uint64_t, Entry> entries;
+        uint64_t nextTicket = 1;
+        bool started = false;
+        uint64_t threads = 0;
+        uint64_t watched = 0;
+        uint64_t cancelled = 0;
+        uint64_t expired = 0;
+    };
+} /* namespace pywrap */
+#endif /* CANCELLATION_H */
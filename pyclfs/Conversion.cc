@@ -0,0 +1,170 @@
+#include <algorithm>
+#include <atomic>
+#include <limits>
+#include <stdexcept>
+#include <ATen/Parallel.h>
+#include "Conversion.h"
+
+namespace pywrap {
+    // 64x64 tiles: a tile of doubles is 32KiB, source rows and destination rows stay in L1/L2
+    constexpr int64_t TILE = 64;
+    // Cells below which one thread is faster than waking up the pool
+    constexpr int64_t GRAIN_CELLS = 1 << 15;
+    bool isSampleMajor(const torch::Tensor& X)
+    {
+        return X.dim() == 2 && (X.size(0) <= 1 || X.stride(0) == 1) && (X.size(1) <= 1 || X.stride(1) == X.size(0));
+    }
+    template <typename S, typename D>
+    void transposeTiles(const S* source, int64_t stride0, int64_t stride1, int64_t features, int64_t samples, D* destination)
+    {
+        // destination[sample, feature] = source[feature * stride0 + sample * stride1]
+        auto tiles = (samples + TILE - 1) / TILE;
+        auto grain = std::max<int64_t>(1, GRAIN_CELLS / std::max<int64_t>(1, TILE * features));
+        at::parallel_for(0, tiles, grain, [&](int64_t begin, int64_t end) {
+            for (int64_t tile = begin; tile < end; ++tile) {
+                auto first = tile * TILE;
+                auto last = std::min(samples, first + TILE);
+                if (stride0 == 1) {
+                    // Rows already sample major: a straight cast the compiler vectorizes
+                    for (int64_t sample = first; sample < last; ++sample) {
+                        const S* in = source + sample * stride1;
+                        D* out = destination + sample * features;
+                        for (int64_t feature = 0; feature < features; ++feature) {
+                            out[feature] = static_cast<D>(in[feature]);
+                        }
+                    }
+                    continue;
+                }
+                for (int64_t block = 0; block < features; block += TILE) {
+                    auto blockEnd = std::min(features, block + TILE);
+                    for (int64_t sample = first; sample < last; ++sample) {
+                        const S* in = source + sample * stride1;
+                        D* out = destination + sample * features;
+                        for (int64_t feature = block; feature < blockEnd; ++feature) {
+                            out[feature] = static_cast<D>(in[feature * stride0]);
+                        }
+                    }
+                }
+            }
+        });
+    }
+    template <typename D>
+    void transposeFrom(const torch::Tensor& X, D* destination)
+    {
+        auto features = X.size(0);
+        auto samples = X.size(1);
+        auto stride0 = X.stride(0);
+        auto stride1 = X.stride(1);
+        switch (X.scalar_type()) {
+            case torch::kUInt8:
+                return transposeTiles(X.const_data_ptr<uint8_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt8:
+                return transposeTiles(X.const_data_ptr<int8_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt16:
+                return transposeTiles(X.const_data_ptr<int16_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt32:
+                return transposeTiles(X.const_data_ptr<int32_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt64:
+                return transposeTiles(X.const_data_ptr<int64_t>(), stride0, stride1, features, samples, destination);
+            case torch::kFloat32:
+                return transposeTiles(X.const_data_ptr<float>(), stride0, stride1, features, samples, destination);
+            case torch::kFloat64:
+                return transposeTiles(X.const_data_ptr<double>(), stride0, stride1, features, samples, destination);
+            default:
+                throw std::runtime_error("transposeInto: unsupported source data type");
+        }
+    }
+    template <typename S, typename D>
+    bool narrowTiles(const S* source, int64_t stride0, int64_t stride1, int64_t features, int64_t samples, D* destination)
+    {
+        // transposeTiles with the range check, a tile stops at its first value out of range and the others
+        // don't start once one did
+        constexpr int64_t high = std::numeric_limits<D>::max();
+        std::atomic<bool> fits{ true };
+        auto tiles = (samples + TILE - 1) / TILE;
+        auto grain = std::max<int64_t>(1, GRAIN_CELLS / std::max<int64_t>(1, TILE * features));
+        at::parallel_for(0, tiles, grain, [&](int64_t begin, int64_t end) {
+            for (int64_t tile = begin; tile < end && fits.load(std::memory_order_relaxed); ++tile) {
+                auto first = tile * TILE;
+                auto last = std::min(samples, first + TILE);
+                bool inRange = true;
+                for (int64_t block = 0; block < features; block += TILE) {
+                    auto blockEnd = std::min(features, block + TILE);
+                    for (int64_t sample = first; sample < last; ++sample) {
+                        const S* in = source + sample * stride1;
+                        D* out = destination + sample * features;
+                        for (int64_t feature = block; feature < blockEnd; ++feature) {
+                            int64_t value = in[feature * stride0];
+                            inRange &= value >= 0 && value <= high;
+                            out[feature] = static_cast<D>(value);
+                        }
+                    }
+                }
+                if (!inRange) {
+                    fits = false;
+                }
+            }
+        });
+        return fits;
+    }
+    template <typename D>
+    bool narrowFrom(const torch::Tensor& X, D* destination)
+    {
+        auto features = X.size(0);
+        auto samples = X.size(1);
+        auto stride0 = X.stride(0);
+        auto stride1 = X.stride(1);
+        switch (X.scalar_type()) {
+            case torch::kInt16:
+                return narrowTiles(X.const_data_ptr<int16_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt32:
+                return narrowTiles(X.const_data_ptr<int32_t>(), stride0, stride1, features, samples, destination);
+            case torch::kInt64:
+                return narrowTiles(X.const_data_ptr<int64_t>(), stride0, stride1, features, samples, destination);
+            default:
+                throw std::runtime_error("narrowInto: Expected int16, int32 or int64 source");
+        }
+    }
+    bool narrowInto(const torch::Tensor& X, torch::ScalarType target, void* destination)
+    {
+        if (X.dim() != 2) {
+            throw std::runtime_error("narrowInto: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
+        }
+        if (X.is_sparse() || !X.is_cpu()) {
+            throw std::runtime_error("narrowInto: Expected a dense cpu tensor");
+        }
+        switch (target) {
+            case torch::kUInt8:
+                return narrowFrom(X, static_cast<uint8_t*>(destination));
+            case torch::kInt16:
+                return narrowFrom(X, static_cast<int16_t*>(destination));
+            default:
+                throw std::runtime_error("narrowInto: Expected uint8 or int16 target");
+        }
+    }
+    void transposeInto(const torch::Tensor& X, torch::ScalarType target, void* destination)
+    {
+        if (X.dim() != 2) {
+            throw std::runtime_error("transposeInto: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
+        }
+        if (X.is_sparse() || !X.is_cpu()) {
+            throw std::runtime_error("transposeInto: Expected a dense cpu tensor");
+        }
+        switch (target) {
+            case torch::kUInt8:
+                return transposeFrom(X, static_cast<uint8_t*>(destination));
+            case torch::kInt8:
+                return transposeFrom(X, static_cast<int8_t*>(destination));
+            case torch::kInt16:
+                return transposeFrom(X, static_cast<int16_t*>(destination));
+            case torch::kInt32:
+                return transposeFrom(X, static_cast<int32_t*>(destination));
+            case torch::kFloat32:
+                return transposeFrom(X, static_cast<float*>(destination));
+            case torch::kFloat64:
+                return transposeFrom(X, static_cast<double*>(destination));
+            default:
+                throw std::runtime_error("transposeInto: unsupported target data type");
+        }
+    }
+} /* namespace pywrap */
@@ -0,0 +1,19 @@
+#ifndef CONVERSION_H
+#define CONVERSION_H
+#include <torch/torch.h>
+
+namespace pywrap {
+    /*
+    Layout and dtype conversion kernels for the tensors handed to Python.
+    They don't touch Python objects, so they run with the GIL released.
+    */
+    // X [features, samples] with any strides into the row major [samples, features] buffer destination
+    // cast to target. Cache-blocked tiles spread over the libtorch intra-op pool
+    void transposeInto(const torch::Tensor& X, torch::ScalarType target, void* destination);
+    // transposeInto of integer X into the narrower integer target, the range is checked in the same pass.
+    // Returns false, with destination partly written, when a value of X doesn't fit in [0, max of target]
+    bool narrowInto(const torch::Tensor& X, torch::ScalarType target, void* destination);
+    // X [features, samples] stored sample major, i.e. its [samples, features] transpose is contiguous
+    bool isSampleMajor(const torch::Tensor& X);
+} /* namespace pywrap */
+#endif /* CONVERSION_H */
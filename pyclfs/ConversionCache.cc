@@ -0,0 +1,61 @@
+#include "ConversionCache.h"
+
+namespace pywrap {
+    bool ConversionCache::matches(const Entry& entry, const torch::Tensor& X, torch::ScalarType target) const
+    {
+        return !entry.tensor.expired() && entry.target == target && entry.storage == X.storage().data()
+            && entry.offset == X.storage_offset() && entry.source == X.scalar_type() && entry.version == X._version()
+            && entry.sizes == X.sizes().vec() && entry.strides == X.strides().vec();
+    }
+    CPyObject ConversionCache::find(const torch::Tensor& X, torch::ScalarType target)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto entry = entries.begin(); entry != entries.end(); ++entry) {
+            if (matches(*entry, X, target)) {
+                entries.splice(entries.begin(), entries, entry);
+                hits++;
+                return entries.front().array;
+            }
+        }
+        misses++;
+        return CPyObject();
+    }
+    void ConversionCache::insert(const torch::Tensor& X, torch::ScalarType target, const CPyObject& array, size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (capacity == 0) {
+            return;
+        }
+        // Entries of tensors that are gone or changed can't match again
+        entries.remove_if([](const Entry& entry) { return entry.tensor.expired(); });
+        entries.push_front(Entry{ X.getIntrusivePtr(), X.storage().data(), X.storage_offset(), X.sizes().vec(), X.strides().vec(),
+                                  X.scalar_type(), target, X._version(), array, bytes });
+        evict();
+    }
+    void ConversionCache::evict()
+    {
+        while (entries.size() > capacity) {
+            entries.pop_back();
+        }
+    }
+    void ConversionCache::setCapacity(size_t entries)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        capacity = entries;
+        evict();
+    }
+    void ConversionCache::clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+    }
+    nlohmann::json ConversionCache::report() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t bytes = 0;
+        for (const auto& entry : entries) {
+            bytes += entry.bytes;
+        }
+        return { { "capacity", capacity }, { "entries", entries.size() }, { "bytes", bytes }, { "hits", hits }, { "misses", misses } };
+    }
+} /* namespace pywrap */
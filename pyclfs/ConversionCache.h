@@ -0,0 +1,51 @@
+#ifndef CONVERSIONCACHE_H
+#define CONVERSIONCACHE_H
+#include <list>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <torch/torch.h>
+#include <nlohmann/json.hpp>
+#include "PyHelper.hpp"
+
+namespace pywrap {
+    /*
+    Numpy arrays converted from tensors, reused while the tensor is alive and unchanged.
+    Entries are keyed by storage, offset, sizes, strides, dtypes and torch's version counter
+    and hold a weak reference to the tensor, so they never keep its memory alive.
+    Every method needs the GIL, the entries own Python references.
+    */
+    class ConversionCache {
+    public:
+        explicit ConversionCache(size_t capacity = 4) : capacity(capacity) {}
+        ~ConversionCache() = default;
+        // Cached array for X converted to target, null when there is none
+        CPyObject find(const torch::Tensor& X, torch::ScalarType target);
+        void insert(const torch::Tensor& X, torch::ScalarType target, const CPyObject& array, size_t bytes);
+        // 0 disables the cache
+        void setCapacity(size_t entries);
+        void clear();
+        nlohmann::json report() const;
+    private:
+        struct Entry {
+            c10::weak_intrusive_ptr<c10::TensorImpl, c10::UndefinedTensorImpl> tensor;
+            const void* storage;
+            int64_t offset;
+            std::vector<int64_t> sizes;
+            std::vector<int64_t> strides;
+            torch::ScalarType source;
+            torch::ScalarType target;
+            int64_t version;
+            CPyObject array;
+            size_t bytes;
+        };
+        bool matches(const Entry& entry, const torch::Tensor& X, torch::ScalarType target) const;
+        void evict();
+        mutable std::mutex mutex;
+        std::list<Entry> entries; // most recently used first
+        size_t capacity;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+} /* namespace pywrap */
+#endif /* CONVERSIONCACHE_H */
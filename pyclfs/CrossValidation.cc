@@ -0,0 +1,124 @@
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <algorithm>
+#include <exception>
+#include <folding.hpp>
+#include "CrossValidation.h"
+
+namespace pywrap {
+    namespace bp = boost::python;
+    namespace np = boost::python::numpy;
+    CPyObject indices2numpy(const std::vector<int>& indices)
+    {
+        // numpy owns the copy, the index array is tiny compared to the dataset
+        auto array = np::empty(bp::make_tuple(indices.size()), np::dtype::get_builtin<int32_t>());
+        std::copy(indices.begin(), indices.end(), reinterpret_cast<int32_t*>(array.get_data()));
+        return bp::incref(bp::object(array).ptr());
+    }
+    std::vector<FoldResult> crossValidate(PyClassifier& clf, torch::Tensor& X, torch::Tensor& y, int folds, bool stratified, int seed, bool parallel)
+    {
+        if (folds < 2) {
+            throw std::invalid_argument("crossValidate: folds must be at least 2, got " + std::to_string(folds));
+        }
+        std::unique_ptr<folding::Fold> fold;
+        if (stratified) {
+            fold = std::make_unique<folding::StratifiedKFold>(folds, y, seed);
+        } else {
+            fold = std::make_unique<folding::KFold>(folds, y.size(0), seed);
+        }
+        auto yc = y.contiguous();
+        auto pyWrap = PyWrap::GetInstance();
+        clf.applyHyperparameters();
+        // X goes through the classifier's own conversion as given, as its fit would hand it to the estimator,
+        // so sample major X stays a view. With a pipeline every fold fits its own copy on the training rows
+        // and converts X through it
+        bool pipelined = !clf.getPreprocessing().empty();
+        std::vector<torch::Tensor> buffers;
+        CPyObject Xp, yp;
+        {
+            PyGILGuard gil;
+            yp = bp::incref(bp::object(labels2numpy(yc, X.size(1))).ptr());
+            if (!pipelined) {
+                Xp = clf.inputArray(X, buffers);
+            }
+        }
+        // Fold generators are not thread safe, get all the splits upfront
+        std::vector<std::pair<std::vector<int>, std::vector<int>>> splits;
+        for (int nFold = 0; nFold < folds; ++nFold) {
+            splits.push_back(fold->getFold(nFold));
+        }
+        std::vector<FoldResult> results(folds);
+        std::vector<std::exception_ptr> errors(folds);
+        auto runFold = [&](int nFold) {
+            auto& result = results[nFold];
+            // Registry ids are addresses, the result slot is unique for the fold
+            auto foldId = reinterpret_cast<clfId_t>(&result);
+            result.fold = nFold;
+            // The interpreter still switches threads and releases the GIL in native sections,
+            // holding it here keeps the index arrays safe until they are released
+            PyGILGuard gil;
+            try {
+                CPyObject trainIdx = indices2numpy(splits[nFold].first);
+                CPyObject testIdx = indices2numpy(splits[nFold].second);
+                pyWrap->cloneClass(clf.getId(), foldId);
+                auto start = std::chrono::steady_clock::now();
+                CPyObject foldX;
+                if (pipelined) {
+                    // Fitted on the training rows only, the test rows stay unseen
+                    Preprocessing pipeline = clf.getPreprocessing();
+                    auto train = torch::tensor(splits[nFold].first, torch::kInt64);
+                    {
+                        PyGILRelease nogil;
+                        pipeline.fit(X.index_select(1, train), yc.index_select(0, train));
+                    }
+                    foldX = clf.inputArray(X, pipeline);
+                }
+                auto& Xfold = pipelined ? foldX : Xp;
+                pyWrap->fit(foldId, Xfold, yp, trainIdx);
+                auto fitted = std::chrono::steady_clock::now();
+                result.score = pyWrap->score(foldId, Xfold, yp, testIdx);
+                auto scored = std::chrono::steady_clock::now();
+                result.fitTime = std::chrono::duration<double>(fitted - start).count();
+                result.scoreTime = std::chrono::duration<double>(scored - fitted).count();
+                pyWrap->clean(foldId);
+            }
+            catch (...) {
+                pyWrap->clean(foldId);
+                errors[nFold] = std::current_exception();
+            }
+        };
+        if (parallel) {
+            auto nThreads = std::min<int>(folds, std::max(1u, std::thread::hardware_concurrency()));
+            std::atomic<int> next{ 0 };
+            std::vector<std::thread> threads;
+            for (int i = 0; i < nThreads; ++i) {
+                threads.emplace_back([&]() {
+                    for (int nFold = next++; nFold < folds; nFold = next++) {
+                        runFold(nFold);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+        } else {
+            for (int nFold = 0; nFold < folds; ++nFold) {
+                runFold(nFold);
+            }
+        }
+        {
+            PyGILGuard gil;
+            Xp.Release();
+            yp.Release();
+            buffers.clear();
+        }
+        for (auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return results;
+    }
+} /* namespace pywrap */
@@ -0,0 +1,25 @@
+#ifndef CROSSVALIDATION_H
+#define CROSSVALIDATION_H
+#include <vector>
+#include <torch/torch.h>
+#include "PyClassifier.h"
+
+namespace pywrap {
+    struct FoldResult {
+        int fold;
+        double score;
+        double fitTime;   // seconds
+        double scoreTime; // seconds
+    };
+    // Owned numpy int32 copy of a fold's indices (caller holds the GIL)
+    CPyObject indices2numpy(const std::vector<int>& indices);
+    /*
+    k-fold cross validation of clf over X [features, samples], y [samples].
+    The dataset is converted once by clf's own input path, every fold gets a deep copy of clf and
+    only index arrays, the rows are gathered on the Python side. A preprocessing pipeline is fitted
+    per fold on its training rows, X is then converted once per fold.
+    Folds run in parallel threads, as far as the backend releases the GIL.
+    */
+    std::vector<FoldResult> crossValidate(PyClassifier& clf, torch::Tensor& X, torch::Tensor& y, int folds, bool stratified, int seed, bool parallel = true);
+} /* namespace pywrap */
+#endif /* CROSSVALIDATION_H */
@@ -0,0 +1,197 @@
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Conversion.h"
+#include "Streaming.h"
+#include "Dataset.h"
+
+namespace pywrap {
+    namespace bp = boost::python;
+    namespace np = boost::python::numpy;
+    namespace {
+        constexpr char MAGIC[8] = { 'P', 'Y', 'C', 'L', 'F', 'D', 'S', '1' };
+        constexpr int64_t PAGE = 4096;
+        const std::map<torch::ScalarType, std::string> dtypeNames = {
+            { torch::kFloat32, "float32" }, { torch::kFloat64, "float64" }, { torch::kUInt8, "uint8" },
+            { torch::kInt8, "int8" }, { torch::kInt16, "int16" }, { torch::kInt32, "int32" }
+        };
+        torch::ScalarType dtypeOf(const std::string& name)
+        {
+            for (const auto& [type, typeName] : dtypeNames) {
+                if (typeName == name) {
+                    return type;
+                }
+            }
+            throw std::runtime_error("MappedDataset: unsupported dtype " + name);
+        }
+    }
+    DatasetWriter::DatasetWriter(const std::string& path, const std::vector<std::string>& features, const std::string& className, torch::ScalarType dtype)
+        : file(path, std::ios::binary | std::ios::trunc), path(path), features(features), className(className), dtype(dtype)
+    {
+        if (dtypeNames.find(dtype) == dtypeNames.end()) {
+            throw std::invalid_argument("DatasetWriter: unsupported dtype");
+        }
+        if (!file) {
+            throw std::runtime_error("DatasetWriter: couldn't create " + path);
+        }
+        // Offsets stay 0 until close, a file left unclosed is refused by MappedDataset
+        std::vector<char> prefix(PAGE, 0);
+        std::memcpy(prefix.data(), MAGIC, sizeof(MAGIC));
+        file.write(prefix.data(), prefix.size());
+    }
+    DatasetWriter::~DatasetWriter() = default;
+    void DatasetWriter::append(const torch::Tensor& X, const torch::Tensor& y)
+    {
+        if (closed) {
+            throw std::runtime_error("DatasetWriter: " + path + " is already closed");
+        }
+        if (X.dim() != 2 || X.size(0) != static_cast<int64_t>(features.size()) || y.numel() != X.size(1)) {
+            throw std::runtime_error("DatasetWriter: expected X [" + std::to_string(features.size()) + ", samples] and y [samples]");
+        }
+        // Row major chunk of the file's dtype out of the parallel conversion kernel
+        buffer.resize(X.numel() * c10::elementSize(dtype));
+        transposeInto(X, dtype, buffer.data());
+        file.write(buffer.data(), buffer.size());
+        auto yi = y.reshape({ -1 }).to(torch::kInt32).contiguous();
+        const int32_t* data = yi.data_ptr<int32_t>();
+        labels.insert(labels.end(), data, data + yi.numel());
+        if (!file) {
+            throw std::runtime_error("DatasetWriter: write failed on " + path);
+        }
+    }
+    void DatasetWriter::close(const std::map<std::string, std::vector<int>>& states)
+    {
+        if (closed) {
+            return;
+        }
+        auto pad = [this]() {
+            int64_t position = file.tellp();
+            auto padded = (position + PAGE - 1) / PAGE * PAGE;
+            std::vector<char> zeros(padded - position, 0);
+            file.write(zeros.data(), zeros.size());
+            return padded;
+        };
+        auto yOffset = pad();
+        file.write(reinterpret_cast<const char*>(labels.data()), labels.size() * sizeof(int32_t));
+        nlohmann::json metadata = {
+            { "format_version", 1 }, { "features", features }, { "class_name", className },
+            { "dtype", dtypeNames.at(dtype) }, { "samples", labels.size() }, { "states", states },
+            { "x_offset", PAGE }, { "y_offset", yOffset }
+        };
+        auto text = metadata.dump();
+        uint64_t offsets[2] = { static_cast<uint64_t>(file.tellp()), text.size() };
+        file.write(text.data(), text.size());
+        file.seekp(sizeof(MAGIC));
+        file.write(reinterpret_cast<const char*>(offsets), sizeof(offsets));
+        file.close();
+        if (!file) {
+            throw std::runtime_error("DatasetWriter: write failed on " + path);
+        }
+        closed = true;
+    }
+    MappedDataset::Mapping::~Mapping()
+    {
+        if (address != nullptr) {
+            munmap(address, length);
+        }
+    }
+    MappedDataset::MappedDataset(const std::string& path) : mapping(std::make_shared<Mapping>())
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("MappedDataset: couldn't open " + path + ": " + std::strerror(errno));
+        }
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size < PAGE) {
+            ::close(fd);
+            throw std::runtime_error("MappedDataset: " + path + " is not a dataset file");
+        }
+        // Private mapping: the pages are the page cache's until somebody writes to them
+        void* address = mmap(nullptr, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("MappedDataset: couldn't map " + path + ": " + std::strerror(errno));
+        }
+        mapping->address = address;
+        mapping->length = info.st_size;
+        auto base = static_cast<char*>(address);
+        if (std::memcmp(base, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("MappedDataset: " + path + " is not a dataset file");
+        }
+        uint64_t offsets[2];
+        std::memcpy(offsets, base + sizeof(MAGIC), sizeof(offsets));
+        if (offsets[0] == 0 || offsets[0] + offsets[1] > mapping->length) {
+            throw std::runtime_error("MappedDataset: " + path + " is incomplete");
+        }
+        metadata = nlohmann::json::parse(base + offsets[0], base + offsets[0] + offsets[1]);
+        features = metadata.at("features").get<std::vector<std::string>>();
+        className = metadata.at("class_name").get<std::string>();
+        states = metadata.at("states").get<std::map<std::string, std::vector<int>>>();
+        samples = metadata.at("samples").get<int64_t>();
+        auto dtype = dtypeOf(metadata.at("dtype").get<std::string>());
+        auto xOffset = metadata.at("x_offset").get<uint64_t>();
+        auto yOffset = metadata.at("y_offset").get<uint64_t>();
+        int64_t nFeatures = features.size();
+        if (xOffset + samples * nFeatures * c10::elementSize(dtype) > yOffset || yOffset + samples * sizeof(int32_t) > offsets[0]) {
+            throw std::runtime_error("MappedDataset: " + path + " is truncated");
+        }
+        // The tensors hold the mapping too, they may outlive the dataset
+        auto keep = mapping;
+        X = torch::from_blob(base + xOffset, { samples, nFeatures }, [keep](void*) {}, torch::TensorOptions().dtype(dtype)).t();
+        y = torch::from_blob(base + yOffset, { samples }, [keep](void*) {}, torch::TensorOptions().dtype(torch::kInt32));
+    }
+    bp::object MappedDataset::owner() const
+    {
+        // The capsule holds the mapping for as long as numpy needs the pages
+        PyObject* capsule = PyCapsule_New(new std::shared_ptr<Mapping>(mapping), "pyclfs.dataset", [](PyObject* capsule) {
+            delete static_cast<std::shared_ptr<Mapping>*>(PyCapsule_GetPointer(capsule, "pyclfs.dataset"));
+        });
+        return bp::object(bp::handle<>(capsule));
+    }
+    np::ndarray MappedDataset::numpyX() const
+    {
+        int64_t element = X.element_size();
+        int64_t nFeatures = features.size();
+        return np::from_data(X.data_ptr(), np::dtype(bp::str(metadata.at("dtype").get<std::string>())),
+                             bp::make_tuple(samples, nFeatures),
+                             bp::make_tuple(nFeatures * element, element),
+                             owner());
+    }
+    np::ndarray MappedDataset::numpyY() const
+    {
+        return np::from_data(y.data_ptr(), np::dtype::get_builtin<int32_t>(),
+                             bp::make_tuple(samples),
+                             bp::make_tuple(sizeof(int32_t)),
+                             owner());
+    }
+    int64_t convertDataset(const std::string& source, const std::string& path, torch::ScalarType dtype, int64_t chunkRows)
+    {
+        if (chunkRows <= 0) {
+            throw std::invalid_argument("convertDataset: chunkRows must be > 0");
+        }
+        auto extension = source.size() >= 5 ? source.substr(source.size() - 5) : "";
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        std::unique_ptr<LabeledSource> reader;
+        if (extension == ".arff") {
+            reader = std::make_unique<ArffSource>(source);
+        } else {
+            reader = std::make_unique<CsvSource>(source);
+        }
+        DatasetWriter writer(path, reader->getFeatures(), reader->getClassName(), dtype);
+        auto rows = torch::empty({ chunkRows, reader->features() }, torch::kFloat32);
+        auto labels = torch::empty({ chunkRows }, torch::kInt32);
+        int64_t total = 0;
+        while (auto count = reader->read(rows.data_ptr<float>(), chunkRows, labels.data_ptr<int32_t>())) {
+            writer.append(rows.narrow(0, 0, count).t(), labels.narrow(0, 0, count));
+            total += count;
+        }
+        // The class states of a CSV are known once every row was read
+        writer.close(reader->getStates());
+        return total;
+    }
+} /* namespace pywrap */
@@ -0,0 +1,80 @@
+#ifndef DATASET_H
+#define DATASET_H
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <torch/torch.h>
+#include <nlohmann/json.hpp>
+#include "boost/python/detail/wrap_python.hpp"
+#include <boost/python/numpy.hpp>
+
+namespace pywrap {
+    /*
+    Binary dataset file, mapped into memory instead of parsed. Little endian:
+        0     "PYCLFDS1"
+        8     uint64 metadata offset
+        16    uint64 metadata length
+        4096  X, [samples, features] row major of the dataset's dtype
+        page  y, [samples] int32
+        ...   metadata, json: features, class_name, dtype, samples, states, x_offset, y_offset
+    The metadata goes last, so converters write the file in one pass. Python reads it with
+        np.memmap(path, dtype, "r", offset=metadata["x_offset"], shape=(samples, features))
+    */
+    // Writes a dataset file chunk by chunk, the labels are kept in memory until close
+    class DatasetWriter {
+    public:
+        // dtype: float32, float64, uint8, int8, int16 or int32
+        DatasetWriter(const std::string& path, const std::vector<std::string>& features, const std::string& className, torch::ScalarType dtype = torch::kFloat32);
+        ~DatasetWriter();
+        DatasetWriter(const DatasetWriter&) = delete;
+        DatasetWriter& operator=(const DatasetWriter&) = delete;
+        // X [features, samples] of any layout and dtype, cast to the file's, y [samples]
+        void append(const torch::Tensor& X, const torch::Tensor& y);
+        // Writes y and the metadata, the file is complete after it
+        void close(const std::map<std::string, std::vector<int>>& states = {});
+    private:
+        std::ofstream file;
+        std::string path;
+        std::vector<std::string> features;
+        std::string className;
+        torch::ScalarType dtype;
+        std::vector<int32_t> labels;
+        std::vector<char> buffer;
+        bool closed = false;
+    };
+    // Dataset file mapped copy on write: the tensors and the numpy arrays share the file's pages
+    class MappedDataset {
+    public:
+        explicit MappedDataset(const std::string& path);
+        // [features, samples] stored sample major, as numpy's [samples, features] C order arrays are
+        torch::Tensor& getX() { return X; }
+        torch::Tensor& getY() { return y; }
+        // numpy arrays over the same pages, they keep the mapping alive on their own (GIL held)
+        boost::python::numpy::ndarray numpyX() const;
+        boost::python::numpy::ndarray numpyY() const;
+        const std::vector<std::string>& getFeatures() const { return features; }
+        const std::string& getClassName() const { return className; }
+        std::map<std::string, std::vector<int>>& getStates() { return states; }
+        int64_t getSamples() const { return samples; }
+        const nlohmann::json& getMetadata() const { return metadata; }
+    private:
+        struct Mapping {
+            void* address = nullptr;
+            size_t length = 0;
+            ~Mapping();
+        };
+        boost::python::object owner() const;
+        std::shared_ptr<Mapping> mapping;
+        nlohmann::json metadata;
+        std::vector<std::string> features;
+        std::string className;
+        std::map<std::string, std::vector<int>> states;
+        int64_t samples = 0;
+        torch::Tensor X, y;
+    };
+    // ARFF (.arff) or CSV file to a dataset file, chunkRows at a time. Returns the samples written
+    int64_t convertDataset(const std::string& source, const std::string& path, torch::ScalarType dtype = torch::kFloat32, int64_t chunkRows = 65536);
+} /* namespace pywrap */
+#endif /* DATASET_H */
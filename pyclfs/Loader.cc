@@ -0,0 +1,376 @@
+#include <algorithm>
+#include <charconv>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <stdexcept>
+#include <string_view>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <ATen/Parallel.h>
+#include "fimdlp/CPPFImdlp.h"
+#include "Streaming.h"
+#include "Loader.h"
+
+namespace pywrap {
+    namespace {
+        constexpr int64_t RANGE_BYTES = 1 << 20; // least bytes of data a parsing range gets
+        using NominalValues = std::map<std::string, int, std::less<>>;
+        class MappedFile {
+        public:
+            explicit MappedFile(const std::string& path)
+            {
+                int fd = ::open(path.c_str(), O_RDONLY);
+                if (fd < 0) {
+                    throw std::runtime_error("loadDataFile: couldn't open " + path + ": " + std::strerror(errno));
+                }
+                struct stat info;
+                if (fstat(fd, &info) != 0) {
+                    ::close(fd);
+                    throw std::runtime_error("loadDataFile: couldn't stat " + path + ": " + std::strerror(errno));
+                }
+                length = info.st_size;
+                if (length > 0) {
+                    address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                }
+                ::close(fd);
+                if (address == MAP_FAILED) {
+                    throw std::runtime_error("loadDataFile: couldn't map " + path + ": " + std::strerror(errno));
+                }
+                // One sequential pass to count the rows, another to parse them
+                if (length > 0) {
+                    madvise(address, length, MADV_SEQUENTIAL);
+                }
+            }
+            ~MappedFile()
+            {
+                if (address != nullptr && address != MAP_FAILED) {
+                    munmap(address, length);
+                }
+            }
+            MappedFile(const MappedFile&) = delete;
+            MappedFile& operator=(const MappedFile&) = delete;
+            const char* data() const { return static_cast<const char*>(address); }
+            size_t size() const { return length; }
+        private:
+            void* address = nullptr;
+            size_t length = 0;
+        };
+        // Line aligned part of the data section
+        struct Range {
+            const char* begin;
+            const char* end;
+            int64_t first = 0; // index of its first row
+            int64_t rows = 0;
+            // CSV class values numbered in order of appearance within the range, merged afterwards
+            NominalValues classCodes;
+            std::vector<std::string> classValues;
+        };
+        std::string_view field(std::string_view text)
+        {
+            auto first = text.find_first_not_of(" \t\r");
+            if (first == std::string_view::npos) {
+                return {};
+            }
+            text = text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+            if (text.size() >= 2 && (text.front() == '\'' || text.front() == '"') && text.back() == text.front()) {
+                return text.substr(1, text.size() - 2);
+            }
+            return text;
+        }
+        // Comma separated values of a line, commas inside quotes don't split. Views into the mapping
+        void splitFields(std::string_view line, std::vector<std::string_view>& fields)
+        {
+            fields.clear();
+            size_t start = 0;
+            char quote = 0;
+            for (size_t i = 0; i < line.size(); ++i) {
+                char c = line[i];
+                if (quote != 0) {
+                    if (c == quote) {
+                        quote = 0;
+                    }
+                } else if (c == '\'' || c == '"') {
+                    quote = c;
+                } else if (c == ',') {
+                    fields.push_back(field(line.substr(start, i - start)));
+                    start = i + 1;
+                }
+            }
+            fields.push_back(field(line.substr(start)));
+        }
+        template<typename T>
+        bool parseNumber(std::string_view text, T& value)
+        {
+            // from_chars doesn't stop at the end of the mapping's last line the way strtod could
+            if (!text.empty() && text.front() == '+') {
+                text.remove_prefix(1);
+            }
+            auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+            return error == std::errc() && end == text.data() + text.size();
+        }
+        // Calls visit with every data line, comments (ARFF) and blank lines left out
+        template<typename Visitor>
+        void forEachRow(const char* begin, const char* end, bool comments, Visitor visit)
+        {
+            while (begin < end) {
+                auto newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+                auto lineEnd = newline == nullptr ? end : newline;
+                std::string_view line(begin, lineEnd - begin);
+                auto first = line.find_first_not_of(" \t\r");
+                if (first != std::string_view::npos && !(comments && line[first] == '%')) {
+                    visit(line);
+                }
+                begin = lineEnd + 1;
+            }
+        }
+        std::vector<Range> splitRanges(const char* begin, const char* end)
+        {
+            int64_t size = end - begin;
+            int64_t count = std::max<int64_t>(1, std::min<int64_t>(at::get_num_threads() * 4, size / RANGE_BYTES));
+            std::vector<Range> ranges;
+            const char* start = begin;
+            for (int64_t i = 1; i <= count && start < end; ++i) {
+                const char* stop = end;
+                if (i < count) {
+                    stop = std::max(start, begin + size * i / count);
+                    auto newline = static_cast<const char*>(std::memchr(stop, '\n', end - stop));
+                    stop = newline == nullptr ? end : newline + 1;
+                }
+                ranges.push_back(Range{ start, stop });
+                start = stop;
+            }
+            return ranges;
+        }
+        struct Schema {
+            std::vector<const NominalValues*> nominal; // of every column, nullptr if numeric
+            std::vector<size_t> featureColumns;
+            size_t classIndex;
+            bool arff;
+        };
+        // Parses the rows of a range. Value (row, feature) goes to base[row * rowStride + feature * featureStride]
+        template<typename T>
+        void parseRange(Range& range, const Schema& schema, const std::string& path, T* base, int64_t rowStride, int64_t featureStride, int32_t* labels)
+        {
+            std::vector<std::string_view> fields;
+            auto columns = schema.nominal.size();
+            int64_t row = range.first;
+            auto where = [&path, &row]() { return " at data row " + std::to_string(row + 1) + " of " + path; };
+            forEachRow(range.begin, range.end, schema.arff, [&](std::string_view line) {
+                if (schema.arff && line[line.find_first_not_of(" \t\r")] == '{') {
+                    throw std::runtime_error("loadDataFile: sparse rows are not supported" + where());
+                }
+                splitFields(line, fields);
+                if (fields.size() != columns) {
+                    throw std::runtime_error("loadDataFile: expected " + std::to_string(columns) + " values" + where());
+                }
+                T* cell = base + row * rowStride;
+                for (size_t column = 0, feature = 0; column < columns; ++column) {
+                    auto value = fields[column];
+                    bool missing = value == "?" || (!schema.arff && value.empty());
+                    if (column == schema.classIndex) {
+                        if (missing) {
+                            labels[row] = -1;
+                        } else if (!schema.arff) {
+                            auto code = range.classCodes.emplace(std::string(value), static_cast<int>(range.classValues.size()));
+                            if (code.second) {
+                                range.classValues.emplace_back(value);
+                            }
+                            labels[row] = code.first->second;
+                        } else if (schema.nominal[column] != nullptr) {
+                            auto found = schema.nominal[column]->find(value);
+                            if (found == schema.nominal[column]->end()) {
+                                throw std::runtime_error("loadDataFile: unknown class value " + std::string(value) + where());
+                            }
+                            labels[row] = found->second;
+                        } else {
+                            double number;
+                            if (!parseNumber(value, number)) {
+                                throw std::runtime_error("loadDataFile: bad number " + std::string(value) + where());
+                            }
+                            labels[row] = static_cast<int32_t>(number);
+                        }
+                        continue;
+                    }
+                    T parsed;
+                    if (missing) {
+                        parsed = std::numeric_limits<T>::quiet_NaN();
+                    } else if (schema.nominal[column] != nullptr) {
+                        auto found = schema.nominal[column]->find(value);
+                        if (found == schema.nominal[column]->end()) {
+                            throw std::runtime_error("loadDataFile: unknown value " + std::string(value) + where());
+                        }
+                        parsed = static_cast<T>(found->second);
+                    } else if (!parseNumber(value, parsed)) {
+                        throw std::runtime_error("loadDataFile: bad number " + std::string(value) + where());
+                    }
+                    cell[feature * featureStride] = parsed;
+                    feature++;
+                }
+                row++;
+            });
+        }
+        template<typename T>
+        void parseRanges(std::vector<Range>& ranges, const Schema& schema, const std::string& path, torch::Tensor& storage, bool sampleMajor, int32_t* labels)
+        {
+            // storage is [samples, features] when sample major, [features, samples] otherwise
+            int64_t rowStride = sampleMajor ? storage.size(1) : 1;
+            int64_t featureStride = sampleMajor ? 1 : storage.size(1);
+            T* base = storage.data_ptr<T>();
+            at::parallel_for(0, ranges.size(), 1, [&](int64_t begin, int64_t end) {
+                for (int64_t i = begin; i < end; ++i) {
+                    parseRange(ranges[i], schema, path, base, rowStride, featureStride, labels);
+                }
+            });
+        }
+        // MDLP discretization of the numeric features of continuous [features, samples] into X
+        void discretize(const torch::Tensor& continuous, const torch::Tensor& y, const Schema& schema, bool sampleMajor, LoadedDataset& dataset)
+        {
+            int64_t nFeatures = continuous.size(0), nSamples = continuous.size(1);
+            const int32_t* labels = y.data_ptr<int32_t>();
+            if (std::find(labels, labels + nSamples, -1) != labels + nSamples) {
+                throw std::runtime_error("loadDataFile: can't discretize with missing class values");
+            }
+            const mdlp::labels_t target(labels, labels + nSamples);
+            auto storage = sampleMajor ? torch::empty({ nSamples, nFeatures }, torch::kInt32) : torch::empty({ nFeatures, nSamples }, torch::kInt32);
+            int64_t rowStride = sampleMajor ? nFeatures : 1;
+            int64_t featureStride = sampleMajor ? 1 : nSamples;
+            int32_t* output = storage.data_ptr<int32_t>();
+            std::vector<int> bins(nFeatures, 0); // 0 for the nominal features, their states stay the file's
+            at::parallel_for(0, nFeatures, 1, [&](int64_t begin, int64_t end) {
+                for (int64_t feature = begin; feature < end; ++feature) {
+                    const float* column = continuous[feature].data_ptr<float>();
+                    if (std::any_of(column, column + nSamples, [](float value) { return std::isnan(value); })) {
+                        throw std::runtime_error("loadDataFile: can't discretize " + dataset.features[feature] + ", it has missing values");
+                    }
+                    int32_t* cell = output + feature * featureStride;
+                    if (schema.nominal[schema.featureColumns[feature]] != nullptr) {
+                        for (int64_t sample = 0; sample < nSamples; ++sample) {
+                            cell[sample * rowStride] = static_cast<int32_t>(column[sample]);
+                        }
+                        continue;
+                    }
+                    // fimdlp takes its own vectors
+                    mdlp::samples_t values(column, column + nSamples);
+                    mdlp::labels_t classes(target);
+                    mdlp::CPPFImdlp discretizer;
+                    discretizer.fit(values, classes);
+                    auto& discretized = discretizer.transform(values);
+                    int maximum = 0;
+                    for (int64_t sample = 0; sample < nSamples; ++sample) {
+                        cell[sample * rowStride] = discretized[sample];
+                        maximum = std::max(maximum, discretized[sample]);
+                    }
+                    bins[feature] = maximum + 1;
+                }
+            });
+            for (int64_t feature = 0; feature < nFeatures; ++feature) {
+                if (bins[feature] > 0) {
+                    std::vector<int> values(bins[feature]);
+                    std::iota(values.begin(), values.end(), 0);
+                    dataset.states[dataset.features[feature]] = values;
+                }
+            }
+            dataset.X = sampleMajor ? storage.t() : storage;
+        }
+    }
+    LoadedDataset loadDataFile(const std::string& path, const LoaderOptions& options)
+    {
+        if (!options.discretize && options.dtype != torch::kFloat32 && options.dtype != torch::kFloat64) {
+            throw std::invalid_argument("loadDataFile: dtype must be float32 or float64");
+        }
+        auto extension = path.size() >= 5 ? path.substr(path.size() - 5) : "";
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        // The header parsers of the streaming sources give the schema, the source outlives the parse
+        // as the nominal value maps are its own
+        LoadedDataset dataset;
+        Schema schema;
+        schema.arff = extension == ".arff";
+        std::unique_ptr<LabeledSource> source;
+        std::streamoff dataOffset;
+        if (schema.arff) {
+            auto arff = std::make_unique<ArffSource>(path, options.className);
+            for (const auto& attribute : arff->getAttributes()) {
+                schema.nominal.push_back(attribute.values.empty() ? nullptr : &attribute.values);
+            }
+            schema.classIndex = arff->getClassIndex();
+            dataOffset = arff->getDataOffset();
+            source = std::move(arff);
+        } else {
+            auto csv = std::make_unique<CsvSource>(path, options.className);
+            schema.nominal.assign(csv->getColumns(), nullptr);
+            schema.classIndex = csv->getClassIndex();
+            dataOffset = csv->getDataOffset();
+            source = std::move(csv);
+        }
+        for (size_t column = 0; column < schema.nominal.size(); ++column) {
+            if (column != schema.classIndex) {
+                schema.featureColumns.push_back(column);
+            }
+        }
+        dataset.features = source->getFeatures();
+        dataset.className = source->getClassName();
+        MappedFile file(path);
+        // tellg is -1 when the header ran into the end of the file
+        const char* begin = file.data() + (dataOffset < 0 ? file.size() : std::min<size_t>(dataOffset, file.size()));
+        const char* end = file.data() + file.size();
+        auto ranges = splitRanges(begin, end);
+        at::parallel_for(0, ranges.size(), 1, [&](int64_t first, int64_t last) {
+            for (int64_t i = first; i < last; ++i) {
+                forEachRow(ranges[i].begin, ranges[i].end, schema.arff, [&ranges, i](std::string_view) { ranges[i].rows++; });
+            }
+        });
+        int64_t nSamples = 0;
+        for (auto& range : ranges) {
+            range.first = nSamples;
+            nSamples += range.rows;
+        }
+        int64_t nFeatures = dataset.features.size();
+        dataset.y = torch::empty({ nSamples }, torch::kInt32);
+        int32_t* labels = dataset.y.data_ptr<int32_t>();
+        // Discretizing reads every feature as one span, so the continuous values go feature major
+        bool sampleMajor = options.sampleMajor && !options.discretize;
+        auto dtype = options.discretize ? torch::kFloat32 : options.dtype;
+        auto storage = sampleMajor ? torch::empty({ nSamples, nFeatures }, dtype) : torch::empty({ nFeatures, nSamples }, dtype);
+        if (dtype == torch::kFloat64) {
+            parseRanges<double>(ranges, schema, path, storage, sampleMajor, labels);
+        } else {
+            parseRanges<float>(ranges, schema, path, storage, sampleMajor, labels);
+        }
+        if (schema.arff) {
+            dataset.states = source->getStates();
+        } else {
+            // Global class codes in order of first appearance, ranges in file order
+            NominalValues codes;
+            std::vector<std::vector<int32_t>> remaps(ranges.size());
+            for (size_t i = 0; i < ranges.size(); ++i) {
+                for (const auto& value : ranges[i].classValues) {
+                    remaps[i].push_back(codes.emplace(value, static_cast<int>(codes.size())).first->second);
+                }
+            }
+            at::parallel_for(0, ranges.size(), 1, [&](int64_t first, int64_t last) {
+                for (int64_t i = first; i < last; ++i) {
+                    for (int64_t row = ranges[i].first; row < ranges[i].first + ranges[i].rows; ++row) {
+                        if (labels[row] >= 0) {
+                            labels[row] = remaps[i][labels[row]];
+                        }
+                    }
+                }
+            });
+            std::vector<int> values(codes.size());
+            std::iota(values.begin(), values.end(), 0);
+            dataset.states[dataset.className] = values;
+        }
+        if (options.discretize) {
+            discretize(storage, dataset.y, schema, options.sampleMajor, dataset);
+        } else {
+            dataset.X = sampleMajor ? storage.t() : storage;
+        }
+        return dataset;
+    }
+} /* namespace pywrap */
@@ -0,0 +1,32 @@
+#ifndef LOADER_H
+#define LOADER_H
+#include <string>
+#include <vector>
+#include <map>
+#include <torch/torch.h>
+
+namespace pywrap {
+    /*
+    Parallel loader of ARFF (.arff) and CSV files. The file is mapped, its data section split in line
+    aligned ranges and every range parsed by a thread of the libtorch intra-op pool straight into
+    the preallocated tensor. The schema comes from the header parsers of ArffSource and CsvSource,
+    values are read as they do: nominal ones as the index of their value, missing ones as NaN.
+    */
+    struct LoaderOptions {
+        std::string className;                  // class attribute or column, the last one when empty
+        torch::ScalarType dtype = torch::kFloat32; // float32 or float64, int32 when discretizing
+        bool sampleMajor = true;                // X's [samples, features] transpose contiguous, as numpy wants it
+        bool discretize = false;                // MDLP discretization of the numeric features
+    };
+    // What PyClassifier::fit takes: X [features, samples], y [samples] int32, and the states of the
+    // class, the nominal features and, when discretized, every feature
+    struct LoadedDataset {
+        torch::Tensor X;
+        torch::Tensor y;
+        std::vector<std::string> features;
+        std::string className;
+        std::map<std::string, std::vector<int>> states;
+    };
+    LoadedDataset loadDataFile(const std::string& path, const LoaderOptions& options = LoaderOptions());
+} /* namespace pywrap */
+#endif /* LOADER_H */
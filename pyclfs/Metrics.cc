@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <set>
+#include <stdexcept>
+#include <ATen/Parallel.h>
+#include "Metrics.h"
+
+namespace pywrap {
+    // Rows below which one thread is faster than waking up the pool
+    constexpr int64_t GRAIN_ROWS = 1 << 14;
+    namespace {
+        const std::set<std::string> labelMetrics = {
+            "accuracy", "balanced_accuracy", "precision_macro", "recall_macro", "f1_macro", "f1_weighted", "confusion_matrix"
+        };
+        const std::set<std::string> probabilityMetrics = { "log_loss", "roc_auc" };
+        torch::Tensor labelsOf(const torch::Tensor& labels, const std::string& name)
+        {
+            if (labels.dim() > 2 || (labels.dim() == 2 && labels.size(1) != 1)) {
+                throw std::runtime_error("Metrics: expected " + name + " of shape [samples]");
+            }
+            return labels.reshape({ -1 }).to(torch::kInt64).contiguous();
+        }
+        // Blocks of rows with their own partial result, one per thread at most
+        int64_t blocksOf(int64_t rows)
+        {
+            return std::max<int64_t>(1, std::min<int64_t>(at::get_num_threads(), rows / GRAIN_ROWS));
+        }
+        // Position of every label in the sorted labels, -1 for the missing ones
+        torch::Tensor indicesOf(const torch::Tensor& labels, const std::vector<int>& sorted)
+        {
+            auto result = torch::empty({ labels.numel() }, torch::kInt64);
+            const int64_t* in = labels.data_ptr<int64_t>();
+            int64_t* out = result.data_ptr<int64_t>();
+            at::parallel_for(0, labels.numel(), GRAIN_ROWS, [&](int64_t begin, int64_t end) {
+                for (int64_t i = begin; i < end; ++i) {
+                    auto found = std::lower_bound(sorted.begin(), sorted.end(), in[i]);
+                    out[i] = found != sorted.end() && *found == in[i] ? found - sorted.begin() : -1;
+                }
+            });
+            return result;
+        }
+        std::vector<int> labelUnion(const std::vector<int>& classes, const torch::Tensor& y, const torch::Tensor& predictions)
+        {
+            std::set<int64_t> labels(classes.begin(), classes.end());
+            for (const auto* tensor : { &y, &predictions }) {
+                const int64_t* data = tensor->data_ptr<int64_t>();
+                for (int64_t i = 0; i < tensor->numel(); ++i) {
+                    labels.insert(data[i]);
+                }
+            }
+            return std::vector<int>(labels.begin(), labels.end());
+        }
+        torch::Tensor probabilitiesOf(const torch::Tensor& probabilities, int64_t rows, const std::vector<int>& classes)
+        {
+            if (!probabilities.defined() || probabilities.dim() != 2 || probabilities.size(0) != rows
+                || probabilities.size(1) != static_cast<int64_t>(classes.size())) {
+                throw std::runtime_error("Metrics: expected probabilities of shape [" + std::to_string(rows) + ", " + std::to_string(classes.size()) + "]");
+            }
+            return probabilities.to(torch::kFloat64).contiguous();
+        }
+        // Area under the ROC curve of one column by the Mann-Whitney statistic, tied scores share their average rank
+        double columnAuc(const double* scores, int64_t columns, int64_t column, const int64_t* truth, int64_t positive, int64_t rows)
+        {
+            std::vector<int64_t> order(rows);
+            std::iota(order.begin(), order.end(), 0);
+            std::sort(order.begin(), order.end(), [&](int64_t a, int64_t b) { return scores[a * columns + column] < scores[b * columns + column]; });
+            double positiveRanks = 0;
+            int64_t positives = 0;
+            for (int64_t first = 0; first < rows;) {
+                auto score = scores[order[first] * columns + column];
+                int64_t last = first;
+                while (last + 1 < rows && scores[order[last + 1] * columns + column] == score) {
+                    last++;
+                }
+                double rank = (first + last) / 2.0 + 1;
+                for (int64_t i = first; i <= last; ++i) {
+                    if (truth[order[i]] == positive) {
+                        positiveRanks += rank;
+                        positives++;
+                    }
+                }
+                first = last + 1;
+            }
+            auto negatives = rows - positives;
+            if (positives == 0 || negatives == 0) {
+                throw std::runtime_error("roc_auc: only one class present in y");
+            }
+            return (positiveRanks - positives * (positives + 1) / 2.0) / (static_cast<double>(positives) * negatives);
+        }
+    }
+    bool needsProbabilities(const std::vector<std::string>& metrics)
+    {
+        return std::any_of(metrics.begin(), metrics.end(), [](const std::string& metric) { return probabilityMetrics.count(metric) > 0; });
+    }
+    double accuracy(const torch::Tensor& y, const torch::Tensor& predictions)
+    {
+        auto truth = labelsOf(y, "y");
+        auto predicted = labelsOf(predictions, "predictions");
+        if (truth.numel() == 0 || truth.numel() != predicted.numel()) {
+            throw std::runtime_error("Metrics: expected y and predictions of the same, non zero, size");
+        }
+        return truth.eq(predicted).sum().item<int64_t>() / static_cast<double>(truth.numel());
+    }
+    torch::Tensor confusionMatrix(const torch::Tensor& y, const torch::Tensor& predictions, const std::vector<int>& labels)
+    {
+        auto truth = indicesOf(labelsOf(y, "y"), labels);
+        auto predicted = indicesOf(labelsOf(predictions, "predictions"), labels);
+        if (truth.numel() != predicted.numel()) {
+            throw std::runtime_error("Metrics: expected y and predictions of the same size");
+        }
+        int64_t k = labels.size();
+        auto rows = truth.numel();
+        auto blocks = blocksOf(rows);
+        // Every block counts into its own matrix, they are added up at the end
+        auto partial = torch::zeros({ blocks, k, k }, torch::kInt64);
+        const int64_t* t = truth.data_ptr<int64_t>();
+        const int64_t* p = predicted.data_ptr<int64_t>();
+        int64_t* counts = partial.data_ptr<int64_t>();
+        at::parallel_for(0, blocks, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t block = begin; block < end; ++block) {
+                int64_t* matrix = counts + block * k * k;
+                for (int64_t i = block * rows / blocks; i < (block + 1) * rows / blocks; ++i) {
+                    // Labels out of the list are left out, like sklearn's labels argument does
+                    if (t[i] >= 0 && p[i] >= 0) {
+                        matrix[t[i] * k + p[i]]++;
+                    }
+                }
+            }
+        });
+        return partial.sum(0).contiguous();
+    }
+    double logLoss(const torch::Tensor& y, const torch::Tensor& probabilities, const std::vector<int>& classes)
+    {
+        auto truth = indicesOf(labelsOf(y, "y"), classes);
+        auto rows = truth.numel();
+        auto scores = probabilitiesOf(probabilities, rows, classes);
+        int64_t k = classes.size();
+        // Clipped to the machine epsilon of the probabilities' dtype, as sklearn does
+        double eps = probabilities.scalar_type() == torch::kFloat32 ? FLT_EPSILON : DBL_EPSILON;
+        const int64_t* t = truth.data_ptr<int64_t>();
+        const double* p = scores.data_ptr<double>();
+        auto blocks = blocksOf(rows);
+        std::vector<double> partial(blocks, 0.0);
+        std::atomic<bool> unknown{ false };
+        at::parallel_for(0, blocks, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t block = begin; block < end; ++block) {
+                double sum = 0;
+                for (int64_t i = block * rows / blocks; i < (block + 1) * rows / blocks; ++i) {
+                    if (t[i] < 0) {
+                        unknown = true;
+                        continue;
+                    }
+                    sum -= std::log(std::clamp(p[i * k + t[i]], eps, 1 - eps));
+                }
+                partial[block] = sum;
+            }
+        });
+        if (unknown) {
+            throw std::runtime_error("log_loss: y has labels out of the estimator's classes");
+        }
+        return std::accumulate(partial.begin(), partial.end(), 0.0) / rows;
+    }
+    double rocAuc(const torch::Tensor& y, const torch::Tensor& probabilities, const std::vector<int>& classes)
+    {
+        auto truth = indicesOf(labelsOf(y, "y"), classes);
+        auto rows = truth.numel();
+        auto scores = probabilitiesOf(probabilities, rows, classes);
+        int64_t k = classes.size();
+        if (k < 2 || truth.min().item<int64_t>() < 0) {
+            throw std::runtime_error("roc_auc: y has labels out of the estimator's classes");
+        }
+        const int64_t* t = truth.data_ptr<int64_t>();
+        const double* p = scores.data_ptr<double>();
+        if (k == 2) {
+            return columnAuc(p, k, 1, t, 1, rows);
+        }
+        // One vs rest, the classes are scored in parallel
+        std::vector<double> areas(k);
+        at::parallel_for(0, k, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t column = begin; column < end; ++column) {
+                areas[column] = columnAuc(p, k, column, t, column, rows);
+            }
+        });
+        return std::accumulate(areas.begin(), areas.end(), 0.0) / k;
+    }
+    nlohmann::json computeMetrics(const std::vector<std::string>& metrics, const torch::Tensor& y, const torch::Tensor& predictions,
+        const torch::Tensor& probabilities, const std::vector<int>& classes)
+    {
+        for (const auto& metric : metrics) {
+            if (labelMetrics.count(metric) == 0 && probabilityMetrics.count(metric) == 0) {
+                throw std::invalid_argument("Unknown metric: " + metric);
+            }
+        }
+        auto truth = labelsOf(y, "y");
+        auto predicted = labelsOf(predictions, "predictions");
+        if (truth.numel() == 0 || truth.numel() != predicted.numel()) {
+            throw std::runtime_error("Metrics: expected y and predictions of the same, non zero, size");
+        }
+        auto known = classes;
+        if (known.empty() && probabilities.defined() && probabilities.dim() == 2) {
+            known.resize(probabilities.size(1));
+            std::iota(known.begin(), known.end(), 0);
+        }
+        nlohmann::json result = nlohmann::json::object();
+        auto rows = static_cast<double>(truth.numel());
+        // Per label counts out of the confusion matrix, every label metric derives from them
+        std::vector<int> labels;
+        std::vector<std::vector<int64_t>> matrix;
+        std::vector<double> precision, recall, f1, support;
+        std::vector<bool> present;
+        int64_t correct = 0;
+        if (std::any_of(metrics.begin(), metrics.end(), [](const std::string& metric) { return labelMetrics.count(metric) > 0; })) {
+            labels = labelUnion(known, truth, predicted);
+            auto counts = confusionMatrix(truth, predicted, labels);
+            size_t k = labels.size();
+            const int64_t* cells = counts.data_ptr<int64_t>();
+            matrix.assign(k, std::vector<int64_t>(k));
+            std::vector<double> predictedCount(k, 0.0);
+            support.assign(k, 0.0);
+            for (size_t row = 0; row < k; ++row) {
+                for (size_t column = 0; column < k; ++column) {
+                    matrix[row][column] = cells[row * k + column];
+                    support[row] += cells[row * k + column];
+                    predictedCount[column] += cells[row * k + column];
+                }
+                correct += cells[row * k + row];
+            }
+            for (size_t label = 0; label < k; ++label) {
+                double hits = matrix[label][label];
+                precision.push_back(predictedCount[label] > 0 ? hits / predictedCount[label] : 0.0);
+                recall.push_back(support[label] > 0 ? hits / support[label] : 0.0);
+                f1.push_back(precision[label] + recall[label] > 0 ? 2 * precision[label] * recall[label] / (precision[label] + recall[label]) : 0.0);
+                present.push_back(support[label] > 0 || predictedCount[label] > 0);
+            }
+        }
+        auto average = [&](const std::vector<double>& values, const std::vector<bool>& mask) {
+            double sum = 0;
+            int count = 0;
+            for (size_t i = 0; i < values.size(); ++i) {
+                if (mask[i]) {
+                    sum += values[i];
+                    count++;
+                }
+            }
+            return count > 0 ? sum / count : 0.0;
+        };
+        for (const auto& metric : metrics) {
+            if (metric == "accuracy") {
+                result[metric] = correct / rows;
+            } else if (metric == "balanced_accuracy") {
+                std::vector<bool> inY;
+                for (auto count : support) {
+                    inY.push_back(count > 0);
+                }
+                result[metric] = average(recall, inY);
+            } else if (metric == "precision_macro") {
+                result[metric] = average(precision, present);
+            } else if (metric == "recall_macro") {
+                result[metric] = average(recall, present);
+            } else if (metric == "f1_macro") {
+                result[metric] = average(f1, present);
+            } else if (metric == "f1_weighted") {
+                double sum = 0;
+                for (size_t i = 0; i < f1.size(); ++i) {
+                    sum += f1[i] * support[i];
+                }
+                result[metric] = sum / rows;
+            } else if (metric == "confusion_matrix") {
+                result[metric] = { { "labels", labels }, { "matrix", matrix } };
+            } else if (metric == "log_loss") {
+                result[metric] = logLoss(truth, probabilities, known);
+            } else if (metric == "roc_auc") {
+                result[metric] = rocAuc(truth, probabilities, known);
+            }
+        }
+        return result;
+    }
+} /* namespace pywrap */
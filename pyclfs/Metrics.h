@@ -0,0 +1,30 @@
+#ifndef METRICS_H
+#define METRICS_H
+#include <string>
+#include <vector>
+#include <torch/torch.h>
+#include <nlohmann/json.hpp>
+
+namespace pywrap {
+    /*
+    Classification metrics computed in C++ out of one predict or predict_proba pass, spread over
+    the libtorch intra-op pool by blocks of rows.
+    y and predictions are label tensors [samples], probabilities are [samples, classes] with the
+    columns in the order of classes (the estimator's classes_, sorted).
+    Metrics: accuracy, balanced_accuracy, precision_macro, recall_macro, f1_macro, f1_weighted,
+    confusion_matrix, log_loss and roc_auc (one vs rest macro average for more than two classes).
+    Averages follow sklearn's: over the labels present in y or the predictions, 0 where undefined.
+    */
+    // True when a metric of the list needs predict_proba
+    bool needsProbabilities(const std::vector<std::string>& metrics);
+    double accuracy(const torch::Tensor& y, const torch::Tensor& predictions);
+    // [labels, labels] counts, rows are the true labels and columns the predicted ones
+    torch::Tensor confusionMatrix(const torch::Tensor& y, const torch::Tensor& predictions, const std::vector<int>& labels);
+    double logLoss(const torch::Tensor& y, const torch::Tensor& probabilities, const std::vector<int>& classes);
+    double rocAuc(const torch::Tensor& y, const torch::Tensor& probabilities, const std::vector<int>& classes);
+    // {metric: value}, the confusion matrix as {"labels": [...], "matrix": [[...]]}. Without classes
+    // the labels are 0..n-1. Throws std::invalid_argument for unknown metrics
+    nlohmann::json computeMetrics(const std::vector<std::string>& metrics, const torch::Tensor& y, const torch::Tensor& predictions,
+        const torch::Tensor& probabilities, const std::vector<int>& classes);
+} /* namespace pywrap */
+#endif /* METRICS_H */
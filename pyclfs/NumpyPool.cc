@@ -0,0 +1,198 @@
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+// numpy 2 headers hide the handler API unless the target version asks for it
+#define NPY_TARGET_VERSION NPY_1_22_API_VERSION
+#define PY_ARRAY_UNIQUE_SYMBOL pywrap_numpypool_ARRAY_API
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <numpy/arrayobject.h>
+#include "NumpyPool.h"
+
+namespace pywrap {
+    NumpyPool& NumpyPool::instance()
+    {
+        // Never destroyed, arrays freed while Python finalizes still come back to it
+        static NumpyPool* pool = new NumpyPool();
+        return *pool;
+    }
+    int NumpyPool::classOf(size_t size)
+    {
+        int shift = MIN_SHIFT;
+        while ((size_t{ 1 } << shift) < size) {
+            shift++;
+        }
+        auto sizeClass = shift - MIN_SHIFT;
+        return sizeClass < CLASSES ? sizeClass : -1;
+    }
+    void* NumpyPool::allocate(size_t size, bool zero)
+    {
+        allocations++;
+        auto sizeClass = classOf(std::max<size_t>(size, 1));
+        Header* header = nullptr;
+        if (sizeClass >= 0) {
+            auto& list = freeLists[sizeClass];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            if (!list.blocks.empty()) {
+                header = list.blocks.back();
+                list.blocks.pop_back();
+            }
+        }
+        if (header != nullptr) {
+            hits++;
+            pooled -= header->size;
+        } else {
+            auto usable = sizeClass >= 0 ? size_t{ 1 } << (sizeClass + MIN_SHIFT) : size;
+            header = static_cast<Header*>(std::malloc(sizeof(Header) + usable));
+            if (header == nullptr) {
+                return nullptr;
+            }
+            header->size = usable;
+            header->sizeClass = sizeClass;
+            if (sizeClass < 0) {
+                large++;
+            }
+        }
+        auto current = inUse += header->size;
+        auto previous = peak.load();
+        while (current > previous && !peak.compare_exchange_weak(previous, current)) {}
+        void* data = header + 1;
+        if (zero) {
+            std::memset(data, 0, size);
+        }
+        return data;
+    }
+    void NumpyPool::release(void* ptr)
+    {
+        if (ptr == nullptr) {
+            return;
+        }
+        frees++;
+        auto header = static_cast<Header*>(ptr) - 1;
+        inUse -= header->size;
+        if (header->sizeClass >= 0 && pooled.load() + static_cast<int64_t>(header->size) <= static_cast<int64_t>(limit.load())) {
+            auto& list = freeLists[header->sizeClass];
+            std::lock_guard<std::mutex> lock(list.mutex);
+            list.blocks.push_back(header);
+            pooled += header->size;
+            return;
+        }
+        std::free(header);
+    }
+    void* NumpyPool::reallocate(void* ptr, size_t size)
+    {
+        if (ptr == nullptr) {
+            return allocate(size, false);
+        }
+        auto header = static_cast<Header*>(ptr) - 1;
+        if (size <= header->size && classOf(std::max<size_t>(size, 1)) == header->sizeClass) {
+            return ptr;
+        }
+        auto data = allocate(size, false);
+        if (data != nullptr) {
+            std::memcpy(data, ptr, std::min<size_t>(size, header->size));
+            release(ptr);
+        }
+        return data;
+    }
+    void NumpyPool::setLimit(size_t bytes)
+    {
+        limit = bytes;
+        trim();
+    }
+    void NumpyPool::trim()
+    {
+        for (auto& list : freeLists) {
+            std::lock_guard<std::mutex> lock(list.mutex);
+            for (auto header : list.blocks) {
+                pooled -= header->size;
+                std::free(header);
+            }
+            list.blocks.clear();
+        }
+    }
+    nlohmann::json NumpyPool::stats() const
+    {
+        return {
+            { "allocations", allocations.load() }, { "frees", frees.load() }, { "pool_hits", hits.load() },
+            { "large_allocations", large.load() }, { "scopes", scopes.load() }, { "bytes_in_use", inUse.load() },
+            { "peak_bytes_in_use", peak.load() }, { "bytes_pooled", pooled.load() }, { "limit", limit.load() }
+        };
+    }
+#ifdef NPY_1_22_API_VERSION
+    namespace {
+        void* poolMalloc(void* ctx, size_t size)
+        {
+            return static_cast<NumpyPool*>(ctx)->allocate(size, false);
+        }
+        void* poolCalloc(void* ctx, size_t elements, size_t size)
+        {
+            return static_cast<NumpyPool*>(ctx)->allocate(elements * size, true);
+        }
+        void* poolRealloc(void* ctx, void* ptr, size_t size)
+        {
+            return static_cast<NumpyPool*>(ctx)->reallocate(ptr, size);
+        }
+        void poolFree(void* ctx, void* ptr, size_t size)
+        {
+            static_cast<NumpyPool*>(ctx)->release(ptr);
+        }
+        PyDataMem_Handler poolHandler = {
+            "pywrap_numpy_pool", 1,
+            { nullptr, poolMalloc, poolCalloc, poolRealloc, poolFree }
+        };
+    }
+    bool NumpyPool::available()
+    {
+        if (!checked) {
+            checked = true;
+            if (_import_array() < 0 || PyArray_GetNDArrayCFeatureVersion() < NPY_1_22_API_VERSION) {
+                PyErr_Clear();
+                return false;
+            }
+            poolHandler.allocator.ctx = this;
+            // Lives as long as the process, arrays made by the pool keep references to it
+            capsule = PyCapsule_New(&poolHandler, "mem_handler", nullptr);
+            if (capsule == nullptr) {
+                PyErr_Clear();
+            }
+        }
+        return capsule != nullptr;
+    }
+    PyObject* NumpyPool::activate()
+    {
+        if (!available()) {
+            return nullptr;
+        }
+        scopes++;
+        auto previous = PyDataMem_SetHandler(capsule);
+        if (previous == nullptr) {
+            PyErr_Clear();
+        }
+        return previous;
+    }
+    void NumpyPool::restore(PyObject* previous)
+    {
+        if (previous == nullptr) {
+            return;
+        }
+        auto ours = PyDataMem_SetHandler(previous);
+        if (ours == nullptr) {
+            PyErr_Clear();
+        }
+        Py_XDECREF(ours);
+        Py_DECREF(previous);
+    }
+#else
+    bool NumpyPool::available()
+    {
+        return false;
+    }
+    PyObject* NumpyPool::activate()
+    {
+        return nullptr;
+    }
+    void NumpyPool::restore(PyObject* previous)
+    {
+    }
+#endif
+} /* namespace pywrap */
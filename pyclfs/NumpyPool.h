@@ -0,0 +1,64 @@
+#ifndef NUMPYPOOL_H
+#define NUMPYPOOL_H
+#include <array>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <nlohmann/json.hpp>
+#include "boost/python/detail/wrap_python.hpp"
+
+namespace pywrap {
+    /*
+    Size-class pool behind numpy's data allocator (PyDataMem_Handler, numpy >= 1.22).
+    Freed array buffers up to 4MiB go to per class free lists and serve later arrays of
+    the same class instead of going back to malloc/free. Larger buffers use malloc directly.
+    numpy keeps the handler of every array, so arrays outlive any change of handler safely.
+    */
+    class NumpyPool {
+    public:
+        static NumpyPool& instance();
+        NumpyPool(const NumpyPool&) = delete;
+        NumpyPool& operator=(const NumpyPool&) = delete;
+        // False when the numpy in use has no data memory handlers (GIL held)
+        bool available();
+        // Makes the pool numpy's allocator of the calling thread's context, returns the previous
+        // handler to give to restore (GIL held). Handlers are per context, so every call sets it
+        PyObject* activate();
+        void restore(PyObject* previous);
+        // Bytes kept in the free lists at most, the rest goes back to the system
+        void setLimit(size_t bytes);
+        // Gives the free lists back to the system
+        void trim();
+        nlohmann::json stats() const;
+        void* allocate(size_t size, bool zero);
+        void* reallocate(void* ptr, size_t size);
+        void release(void* ptr);
+    private:
+        NumpyPool() = default;
+        static constexpr int MIN_SHIFT = 6; // 64 bytes
+        static constexpr int CLASSES = 17; // up to 4MiB
+        struct alignas(16) Header {
+            uint64_t size; // usable bytes
+            int32_t sizeClass; // -1 for blocks from malloc
+        };
+        struct FreeList {
+            std::mutex mutex;
+            std::vector<Header*> blocks;
+        };
+        static int classOf(size_t size);
+        std::array<FreeList, CLASSES> freeLists;
+        PyObject* capsule = nullptr;
+        bool checked = false;
+        std::atomic<size_t> limit{ 256u << 20 };
+        std::atomic<uint64_t> allocations{ 0 };
+        std::atomic<uint64_t> frees{ 0 };
+        std::atomic<uint64_t> hits{ 0 };
+        std::atomic<uint64_t> large{ 0 };
+        std::atomic<uint64_t> scopes{ 0 };
+        std::atomic<int64_t> inUse{ 0 };
+        std::atomic<int64_t> peak{ 0 };
+        std::atomic<int64_t> pooled{ 0 };
+    };
+} /* namespace pywrap */
+#endif /* NUMPYPOOL_H */
@@ -4,18 +4,20 @@ namespace pywrap {
     ODTE::ODTE() : PyClassifier("odte", "Odte")
     {
         validHyperparameters = { "n_jobs", "n_estimators", "random_state", "max_samples", "max_features", "be_hyperparams" };
+        inputDtype = torch::kFloat64;
+        sampleMajor = true;
     }
     int ODTE::getNumberOfNodes() const
     {
-        return callMethodInt("get_nodes");
+        return metadataInt("nodes");
     }
     int ODTE::getNumberOfEdges() const
     {
-        return callMethodInt("get_leaves");
+        return metadataInt("leaves");
     }
     int ODTE::getNumberOfStates() const
     {
-        return callMethodInt("get_depth");
+        return metadataInt("depth");
     }
     std::string ODTE::graph()
     {
@@ -0,0 +1,136 @@
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <pthread.h>
+#include "Placement.h"
+
+namespace pywrap {
+    namespace {
+        thread_local const Placement* currentPlacement = nullptr;
+    }
+    std::vector<int> parseCpuList(const std::string& list)
+    {
+        // Format "0-7,16-23"
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty() || range == "\n") {
+                continue;
+            }
+            auto dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+    Placement Placement::cpuSet(const std::vector<int>& cpus)
+    {
+        for (auto cpu : cpus) {
+            if (cpu < 0) {
+                throw std::invalid_argument("Placement: invalid cpu " + std::to_string(cpu));
+            }
+        }
+        Placement placement;
+        placement.cpus = cpus;
+        return placement;
+    }
+    Placement Placement::numaNode(int node)
+    {
+        auto cpus = nodeCpus(node);
+        if (cpus.empty()) {
+            throw std::invalid_argument("Placement: no cpus found for NUMA node " + std::to_string(node));
+        }
+        Placement placement;
+        placement.cpus = cpus;
+        placement.node = node;
+        return placement;
+    }
+    int Placement::numaNodes()
+    {
+        int nodes = 0;
+        while (std::filesystem::exists("/sys/devices/system/node/node" + std::to_string(nodes))) {
+            nodes++;
+        }
+        return std::max(nodes, 1);
+    }
+    std::vector<int> Placement::nodeCpus(int node)
+    {
+        std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        std::string list;
+        if (!std::getline(file, list)) {
+            return {};
+        }
+        return parseCpuList(list);
+    }
+    std::string Placement::toString() const
+    {
+        if (empty()) {
+            return "Placement: none";
+        }
+        std::stringstream oss;
+        oss << "Placement: ";
+        if (node >= 0) {
+            oss << "numa node " << node << " ";
+        }
+        oss << "cpus";
+        // Compact the list back to ranges
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            size_t j = i;
+            while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1) {
+                j++;
+            }
+            oss << (i == 0 ? " " : ",") << cpus[i];
+            if (j > i) {
+                oss << "-" << cpus[j];
+            }
+            i = j;
+        }
+        return oss.str();
+    }
+    nlohmann::json Placement::toJson() const
+    {
+        return { { "cpus", cpus }, { "numa_node", node } };
+    }
+    PlacementScope::PlacementScope(const Placement& placement)
+    {
+#ifdef __linux__
+        if (placement.empty()) {
+            return;
+        }
+        if (pthread_getaffinity_np(pthread_self(), sizeof(previous), &previous) != 0) {
+            return;
+        }
+        cpu_set_t mask;
+        CPU_ZERO(&mask);
+        for (auto cpu : placement.getCpus()) {
+            if (cpu < CPU_SETSIZE) {
+                CPU_SET(cpu, &mask);
+            }
+        }
+        pinned = pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) == 0;
+        if (pinned) {
+            previousPlacement = currentPlacement;
+            currentPlacement = &placement;
+        }
+#endif
+    }
+    PlacementScope::~PlacementScope()
+    {
+#ifdef __linux__
+        if (pinned) {
+            pthread_setaffinity_np(pthread_self(), sizeof(previous), &previous);
+            currentPlacement = previousPlacement;
+        }
+#endif
+    }
+    const Placement* PlacementScope::current()
+    {
+        return currentPlacement;
+    }
+} /* namespace pywrap */
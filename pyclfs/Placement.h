@@ -0,0 +1,54 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace pywrap {
+    /*
+    Where the Python compute of a classifier runs: a set of cpus or a NUMA node.
+    Only effective on linux, elsewhere placements are accepted and ignored.
+    */
+    class Placement {
+    public:
+        Placement() = default;
+        static Placement cpuSet(const std::vector<int>& cpus);
+        static Placement numaNode(int node);
+        bool empty() const { return cpus.empty(); }
+        int getNode() const { return node; }
+        const std::vector<int>& getCpus() const { return cpus; }
+        std::string toString() const;
+        nlohmann::json toJson() const;
+        // Number of NUMA nodes of the host (1 when unknown)
+        static int numaNodes();
+        // cpus of a NUMA node, from /sys/devices/system/node/node<n>/cpulist
+        static std::vector<int> nodeCpus(int node);
+    private:
+        std::vector<int> cpus;
+        int node = -1;
+    };
+    /*
+    Pins the calling thread to a placement for its lifetime and restores the previous mask.
+    Native threads created meanwhile (OpenMP, joblib) inherit the mask, already running pools don't.
+    */
+    class PlacementScope {
+    public:
+        explicit PlacementScope(const Placement& placement);
+        ~PlacementScope();
+        PlacementScope(const PlacementScope&) = delete;
+        PlacementScope& operator=(const PlacementScope&) = delete;
+        bool active() const { return pinned; }
+        // Placement the calling thread is pinned to by its innermost active scope, nullptr without any
+        static const Placement* current();
+    private:
+        bool pinned = false;
+        const Placement* previousPlacement = nullptr;
+#ifdef __linux__
+        cpu_set_t previous;
+#endif
+    };
+} /* namespace pywrap */
+#endif /* PLACEMENT_H */
@@ -0,0 +1,377 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <ATen/Parallel.h>
+#include "fimdlp/CPPFImdlp.h"
+#include "Preprocessing.h"
+
+namespace pywrap {
+    // Same tiling as the plain conversion kernel (Conversion.cc)
+    constexpr int64_t TILE = 64;
+    constexpr int64_t GRAIN_CELLS = 1 << 15;
+    Preprocessing::Preprocessing(const nlohmann::json& pipeline)
+    {
+        const auto& declared = pipeline.is_object() ? pipeline.at("steps") : pipeline;
+        if (!declared.is_array()) {
+            throw std::invalid_argument("Preprocessing: expected an array of steps");
+        }
+        bool parameters = true;
+        for (const auto& item : declared) {
+            auto name = item.at("step").get<std::string>();
+            if (name == "select") {
+                select(item.at("features").get<std::vector<int64_t>>());
+            } else if (name == "standard") {
+                standardize();
+                parameters = parameters && item.contains("mean") && item.contains("std");
+                if (parameters) {
+                    steps.back().first = item.at("mean").get<std::vector<double>>();
+                    steps.back().second = item.at("std").get<std::vector<double>>();
+                }
+            } else if (name == "minmax") {
+                auto range = item.value("range", std::vector<double>{ 0.0, 1.0 });
+                if (range.size() != 2) {
+                    throw std::invalid_argument("Preprocessing: minmax range must be [low, high]");
+                }
+                minMax(range[0], range[1]);
+                parameters = parameters && item.contains("min") && item.contains("max");
+                if (parameters) {
+                    steps.back().first = item.at("min").get<std::vector<double>>();
+                    steps.back().second = item.at("max").get<std::vector<double>>();
+                }
+            } else if (name == "mdlp") {
+                discretize();
+                parameters = parameters && item.contains("edges");
+                if (parameters) {
+                    steps.back().edges = item.at("edges").get<std::vector<std::vector<float>>>();
+                }
+            } else {
+                throw std::invalid_argument("Preprocessing: unknown step " + name);
+            }
+        }
+        if (pipeline.is_object() && parameters) {
+            // A fitted pipeline coming back
+            nInputs = pipeline.at("features").get<int64_t>();
+            compile();
+            fitted = true;
+        }
+    }
+    Preprocessing& Preprocessing::select(const std::vector<int64_t>& features)
+    {
+        if (!steps.empty()) {
+            throw std::invalid_argument("Preprocessing: select must be the first step");
+        }
+        if (features.empty() || std::any_of(features.begin(), features.end(), [](int64_t feature) { return feature < 0; })) {
+            throw std::invalid_argument("Preprocessing: select needs feature indices >= 0");
+        }
+        steps.push_back({ Kind::Select, features });
+        fitted = false;
+        return *this;
+    }
+    Preprocessing& Preprocessing::standardize()
+    {
+        steps.push_back({ Kind::Standard });
+        fitted = false;
+        return *this;
+    }
+    Preprocessing& Preprocessing::minMax(double low, double high)
+    {
+        if (!(low < high)) {
+            throw std::invalid_argument("Preprocessing: minmax range must have low < high");
+        }
+        Step step{ Kind::MinMax };
+        step.low = low;
+        step.high = high;
+        steps.push_back(step);
+        fitted = false;
+        return *this;
+    }
+    Preprocessing& Preprocessing::discretize()
+    {
+        if (std::any_of(steps.begin(), steps.end(), [](const Step& step) { return step.kind == Kind::Mdlp; })) {
+            throw std::invalid_argument("Preprocessing: only one mdlp step");
+        }
+        steps.push_back({ Kind::Mdlp });
+        fitted = false;
+        return *this;
+    }
+    void Preprocessing::fold(const Step& step, size_t k, double& scale, double& offset)
+    {
+        double factor, shift;
+        if (step.kind == Kind::Standard) {
+            // Constant features are centered only, as sklearn's StandardScaler does
+            double deviation = step.second[k] == 0.0 ? 1.0 : step.second[k];
+            factor = 1.0 / deviation;
+            shift = -step.first[k] / deviation;
+        } else if (step.kind == Kind::MinMax) {
+            double range = step.second[k] - step.first[k];
+            factor = (step.high - step.low) / (range == 0.0 ? 1.0 : range);
+            shift = step.low - step.first[k] * factor;
+        } else {
+            return;
+        }
+        scale *= factor;
+        offset = offset * factor + shift;
+    }
+    void Preprocessing::fit(const torch::Tensor& X, const torch::Tensor& y)
+    {
+        if (X.dim() != 2 || y.numel() != X.size(1)) {
+            throw std::runtime_error("Preprocessing: expected X [features, samples] and y [samples]");
+        }
+        if (X.is_sparse()) {
+            throw std::runtime_error("Preprocessing: sparse X is not supported");
+        }
+        nInputs = X.size(0);
+        int64_t samples = X.size(1);
+        std::vector<int64_t> chosen(nInputs);
+        std::iota(chosen.begin(), chosen.end(), 0);
+        if (!steps.empty() && steps.front().kind == Kind::Select) {
+            chosen = steps.front().features;
+            for (auto feature : chosen) {
+                if (feature >= nInputs) {
+                    throw std::runtime_error("Preprocessing: selected feature " + std::to_string(feature) + " of " + std::to_string(nInputs));
+                }
+            }
+        }
+        size_t outputs = chosen.size();
+        for (auto& step : steps) {
+            step.first.assign(step.kind == Kind::Standard || step.kind == Kind::MinMax ? outputs : 0, 0.0);
+            step.second.assign(step.first.size(), 0.0);
+            step.edges.assign(step.kind == Kind::Mdlp ? outputs : 0, {});
+        }
+        auto yi = y.reshape({ -1 }).to(torch::kInt32).contiguous();
+        const mdlp::labels_t labels(yi.data_ptr<int32_t>(), yi.data_ptr<int32_t>() + samples);
+        // Features are fitted on their own, every one runs its steps on its column in turn.
+        // The values each step sees are computed the way the fused kernel computes them
+        at::parallel_for(0, outputs, 1, [&](int64_t begin, int64_t end) {
+            for (int64_t k = begin; k < end; ++k) {
+                auto column = X[chosen[k]].to(torch::kFloat64).contiguous();
+                std::vector<double> values(column.data_ptr<double>(), column.data_ptr<double>() + samples);
+                double scale = 1.0, offset = 0.0;
+                for (auto& step : steps) {
+                    if (step.kind == Kind::Standard) {
+                        double sum = 0.0;
+                        for (auto value : values) {
+                            sum += value * scale + offset;
+                        }
+                        double mean = sum / samples, squares = 0.0;
+                        for (auto value : values) {
+                            double centered = value * scale + offset - mean;
+                            squares += centered * centered;
+                        }
+                        step.first[k] = mean;
+                        step.second[k] = std::sqrt(squares / samples);
+                    } else if (step.kind == Kind::MinMax) {
+                        double low = std::numeric_limits<double>::infinity(), high = -low;
+                        for (auto value : values) {
+                            low = std::min(low, value * scale + offset);
+                            high = std::max(high, value * scale + offset);
+                        }
+                        step.first[k] = low;
+                        step.second[k] = high;
+                    } else if (step.kind == Kind::Mdlp) {
+                        mdlp::samples_t points(samples);
+                        for (int64_t sample = 0; sample < samples; ++sample) {
+                            points[sample] = static_cast<float>(values[sample] * scale + offset);
+                        }
+                        mdlp::labels_t target(labels);
+                        mdlp::CPPFImdlp discretizer;
+                        discretizer.fit(points, target);
+                        auto& bins = discretizer.transform(points);
+                        // Edge of bin b is its smallest point: the bins the kernel gives back on the
+                        // training data are fimdlp's, whatever its convention on the cut points
+                        int maximum = bins.empty() ? 0 : *std::max_element(bins.begin(), bins.end());
+                        std::vector<float> cuts(maximum, std::numeric_limits<float>::infinity());
+                        for (int64_t sample = 0; sample < samples; ++sample) {
+                            if (bins[sample] > 0) {
+                                cuts[bins[sample] - 1] = std::min(cuts[bins[sample] - 1], points[sample]);
+                            }
+                        }
+                        // A bin left empty gets no width, the edges stay sorted
+                        for (int bin = maximum - 2; bin >= 0; --bin) {
+                            cuts[bin] = std::min(cuts[bin], cuts[bin + 1]);
+                        }
+                        step.edges[k] = cuts;
+                        values.assign(bins.begin(), bins.end());
+                        scale = 1.0;
+                        offset = 0.0;
+                        continue;
+                    }
+                    fold(step, k, scale, offset);
+                }
+            }
+        });
+        compile();
+        fitted = true;
+    }
+    void Preprocessing::compile()
+    {
+        bool selecting = !steps.empty() && steps.front().kind == Kind::Select;
+        if (selecting) {
+            sources = steps.front().features;
+        } else {
+            sources.resize(nInputs);
+            std::iota(sources.begin(), sources.end(), 0);
+        }
+        auto outputs = sources.size();
+        for (const auto& step : steps) {
+            bool sized = step.kind == Kind::Select || (step.kind == Kind::Mdlp ? step.edges.size() == outputs : step.first.size() == outputs && step.second.size() == outputs);
+            if (!sized) {
+                throw std::invalid_argument("Preprocessing: the parameters don't match the " + std::to_string(outputs) + " features");
+            }
+        }
+        gathering = selecting;
+        binning = std::any_of(steps.begin(), steps.end(), [](const Step& step) { return step.kind == Kind::Mdlp; });
+        scale.assign(outputs, 1.0);
+        offset.assign(outputs, 0.0);
+        binScale.assign(outputs, 1.0);
+        binOffset.assign(outputs, 0.0);
+        edges.assign(outputs, {});
+        for (size_t k = 0; k < outputs; ++k) {
+            bool binned = false;
+            for (const auto& step : steps) {
+                if (step.kind == Kind::Mdlp) {
+                    edges[k] = step.edges[k];
+                    binned = true;
+                } else if (binned) {
+                    fold(step, k, binScale[k], binOffset[k]);
+                } else {
+                    fold(step, k, scale[k], offset[k]);
+                }
+            }
+        }
+    }
+    template <typename S, typename D>
+    void Preprocessing::transformTiles(const S* source, int64_t stride0, int64_t stride1, int64_t samples, D* destination) const
+    {
+        // destination[sample, k] = f_k(source[sources[k] * stride0 + sample * stride1])
+        int64_t outputs = sources.size();
+        auto tiles = (samples + TILE - 1) / TILE;
+        auto grain = std::max<int64_t>(1, GRAIN_CELLS / std::max<int64_t>(1, TILE * outputs));
+        at::parallel_for(0, tiles, grain, [&](int64_t begin, int64_t end) {
+            for (int64_t tile = begin; tile < end; ++tile) {
+                auto first = tile * TILE;
+                auto last = std::min(samples, first + TILE);
+                if (!binning && !gathering && stride0 == 1) {
+                    // Sample major rows scaled as they are: a multiply-add over the row the compiler vectorizes
+                    for (int64_t sample = first; sample < last; ++sample) {
+                        const S* in = source + sample * stride1;
+                        D* out = destination + sample * outputs;
+                        for (int64_t k = 0; k < outputs; ++k) {
+                            out[k] = static_cast<D>(static_cast<double>(in[k]) * scale[k] + offset[k]);
+                        }
+                    }
+                    continue;
+                }
+                // A feature at a time over the tile: its parameters stay in registers
+                for (int64_t k = 0; k < outputs; ++k) {
+                    const S* in = source + sources[k] * stride0;
+                    D* out = destination + k;
+                    double a = scale[k], b = offset[k];
+                    if (!binning) {
+                        for (int64_t sample = first; sample < last; ++sample) {
+                            out[sample * outputs] = static_cast<D>(static_cast<double>(in[sample * stride1]) * a + b);
+                        }
+                        continue;
+                    }
+                    const auto& cuts = edges[k];
+                    double c = binScale[k], d = binOffset[k];
+                    for (int64_t sample = first; sample < last; ++sample) {
+                        auto value = static_cast<float>(static_cast<double>(in[sample * stride1]) * a + b);
+                        auto bin = std::upper_bound(cuts.begin(), cuts.end(), value) - cuts.begin();
+                        out[sample * outputs] = static_cast<D>(bin * c + d);
+                    }
+                }
+            }
+        });
+    }
+    template <typename D>
+    void Preprocessing::transformFrom(const torch::Tensor& X, D* destination) const
+    {
+        auto samples = X.size(1);
+        auto stride0 = X.stride(0);
+        auto stride1 = X.stride(1);
+        switch (X.scalar_type()) {
+            case torch::kUInt8:
+                return transformTiles(X.const_data_ptr<uint8_t>(), stride0, stride1, samples, destination);
+            case torch::kInt8:
+                return transformTiles(X.const_data_ptr<int8_t>(), stride0, stride1, samples, destination);
+            case torch::kInt16:
+                return transformTiles(X.const_data_ptr<int16_t>(), stride0, stride1, samples, destination);
+            case torch::kInt32:
+                return transformTiles(X.const_data_ptr<int32_t>(), stride0, stride1, samples, destination);
+            case torch::kInt64:
+                return transformTiles(X.const_data_ptr<int64_t>(), stride0, stride1, samples, destination);
+            case torch::kFloat32:
+                return transformTiles(X.const_data_ptr<float>(), stride0, stride1, samples, destination);
+            case torch::kFloat64:
+                return transformTiles(X.const_data_ptr<double>(), stride0, stride1, samples, destination);
+            default:
+                throw std::runtime_error("Preprocessing: unsupported source data type");
+        }
+    }
+    void Preprocessing::transformInto(const torch::Tensor& X, torch::ScalarType target, void* destination) const
+    {
+        if (!fitted) {
+            throw std::runtime_error("Preprocessing: transform before fit");
+        }
+        if (X.dim() != 2 || X.size(0) != nInputs) {
+            throw std::runtime_error("Preprocessing: expected X [" + std::to_string(nInputs) + ", samples]");
+        }
+        if (X.is_sparse() || !X.is_cpu()) {
+            throw std::runtime_error("Preprocessing: expected a dense cpu tensor");
+        }
+        switch (target) {
+            case torch::kFloat32:
+                return transformFrom(X, static_cast<float*>(destination));
+            case torch::kFloat64:
+                return transformFrom(X, static_cast<double*>(destination));
+            case torch::kInt32:
+                return transformFrom(X, static_cast<int32_t*>(destination));
+            default:
+                throw std::runtime_error("Preprocessing: unsupported target data type");
+        }
+    }
+    torch::Tensor Preprocessing::transform(const torch::Tensor& X, torch::ScalarType target) const
+    {
+        auto result = torch::empty({ X.size(1), outputFeatures() }, target);
+        transformInto(X, target, result.data_ptr());
+        return result.t();
+    }
+    nlohmann::json Preprocessing::toJson() const
+    {
+        auto declared = nlohmann::json::array();
+        for (const auto& step : steps) {
+            switch (step.kind) {
+                case Kind::Select:
+                    declared.push_back({ { "step", "select" }, { "features", step.features } });
+                    break;
+                case Kind::Standard:
+                    declared.push_back({ { "step", "standard" } });
+                    if (fitted) {
+                        declared.back()["mean"] = step.first;
+                        declared.back()["std"] = step.second;
+                    }
+                    break;
+                case Kind::MinMax:
+                    declared.push_back({ { "step", "minmax" }, { "range", { step.low, step.high } } });
+                    if (fitted) {
+                        declared.back()["min"] = step.first;
+                        declared.back()["max"] = step.second;
+                    }
+                    break;
+                case Kind::Mdlp:
+                    declared.push_back({ { "step", "mdlp" } });
+                    if (fitted) {
+                        declared.back()["edges"] = step.edges;
+                    }
+                    break;
+            }
+        }
+        if (!fitted) {
+            return declared;
+        }
+        return { { "features", nInputs }, { "steps", declared } };
+    }
+} /* namespace pywrap */
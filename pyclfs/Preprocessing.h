@@ -0,0 +1,69 @@
+#ifndef PREPROCESSING_H
+#define PREPROCESSING_H
+#include <vector>
+#include <torch/torch.h>
+#include <nlohmann/json.hpp>
+
+namespace pywrap {
+    /*
+    Preprocessing of X fused into its conversion for the estimator: the selected features go through
+    their steps and are cast to the estimator's dtype in the same parallel pass that lays them out
+    sample major, at fit and at predict time alike. Declared as json, in the order the steps run:
+        [ { "step": "select", "features": [0, 2, 3] },
+          { "step": "standard" },                       // (x - mean) / std
+          { "step": "minmax", "range": [0, 1] },        // x scaled from [min, max] to range
+          { "step": "mdlp" } ]                          // bin of x, MDLP cut points fitted on y
+    Fitting adds the parameters to every step (mean/std, min/max, edges). toJson of a fitted pipeline
+    is { "features": inputs, "steps": [...] }, which the constructor takes back as a fitted pipeline.
+    */
+    class Preprocessing {
+    public:
+        Preprocessing() = default;
+        explicit Preprocessing(const nlohmann::json& pipeline);
+        // Builders, each appends a step
+        Preprocessing& select(const std::vector<int64_t>& features);
+        Preprocessing& standardize();
+        Preprocessing& minMax(double low = 0.0, double high = 1.0);
+        Preprocessing& discretize();
+        bool empty() const { return steps.empty(); }
+        bool isFitted() const { return fitted; }
+        // Learns the parameters of every step from X [features, samples] and y [samples]
+        void fit(const torch::Tensor& X, const torch::Tensor& y);
+        int64_t inputFeatures() const { return nInputs; }
+        int64_t outputFeatures() const { return static_cast<int64_t>(sources.size()); }
+        // X [inputFeatures, samples] of any layout and dtype into the row major [samples, outputFeatures]
+        // buffer destination cast to target, one pass spread over the libtorch intra-op pool
+        void transformInto(const torch::Tensor& X, torch::ScalarType target, void* destination) const;
+        // Same into a new [outputFeatures, samples] sample major tensor
+        torch::Tensor transform(const torch::Tensor& X, torch::ScalarType target = torch::kFloat32) const;
+        nlohmann::json toJson() const;
+    private:
+        enum class Kind { Select, Standard, MinMax, Mdlp };
+        struct Step {
+            Kind kind;
+            std::vector<int64_t> features; // select
+            double low = 0.0, high = 1.0; // minmax range
+            // Fitted per output feature: mean/std (standard), min/max (minmax)
+            std::vector<double> first, second;
+            std::vector<std::vector<float>> edges; // mdlp, x >= edges[i] is bin i + 1
+        };
+        // Folds step's transform of output feature k into x * scale + offset
+        static void fold(const Step& step, size_t k, double& scale, double& offset);
+        void compile();
+        template <typename S, typename D>
+        void transformTiles(const S* source, int64_t stride0, int64_t stride1, int64_t samples, D* destination) const;
+        template <typename D>
+        void transformFrom(const torch::Tensor& X, D* destination) const;
+        std::vector<Step> steps;
+        int64_t nInputs = 0;
+        bool fitted = false;
+        // Steps folded per output feature: x = X[source] * scale + offset, then, when binned, the bin
+        // of x mapped by binScale and binOffset
+        std::vector<int64_t> sources;
+        std::vector<double> scale, offset, binScale, binOffset;
+        std::vector<std::vector<float>> edges;
+        bool binning = false; // every feature is binned by the mdlp step
+        bool gathering = false; // selected features, otherwise output k is input k
+    };
+} /* namespace pywrap */
+#endif /* PREPROCESSING_H */
@@ -1,4 +1,13 @@
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+#include <numeric>
+#include <array>
+#include <thread>
+#include <condition_variable>
+#include <exception>
 #include "PyClassifier.h"
+#include "Conversion.h"
 namespace pywrap {
     namespace bp = boost::python;
     namespace np = boost::python::numpy;
@@ -6,43 +15,116 @@ namespace pywrap {
     {
         // This id allows to have more than one instance of the same module/class
         id = reinterpret_cast<clfId_t>(this);
+        primary.id = id;
         pyWrap = PyWrap::GetInstance();
         pyWrap->importClass(id, module, className);
     }
     PyClassifier::~PyClassifier()
     {
+        {
+            // Cached arrays are Python objects
+            PyGILGuard gil;
+            conversions.clear();
+            resetRowPath();
+        }
+        dropReplicas();
         pyWrap->clean(id);
     }
+    np::dtype numpyDtype(torch::ScalarType type)
+    {
+        switch (type) {
+            case torch::kFloat32:
+                return np::dtype::get_builtin<float>();
+            case torch::kFloat64:
+                return np::dtype::get_builtin<double>();
+            case torch::kUInt8:
+                return np::dtype::get_builtin<uint8_t>();
+            case torch::kInt8:
+                return np::dtype::get_builtin<int8_t>();
+            case torch::kInt16:
+                return np::dtype::get_builtin<int16_t>();
+            case torch::kInt32:
+                return np::dtype::get_builtin<int32_t>();
+            default:
+                throw std::runtime_error("numpyDtype: unsupported data type");
+        }
+    }
+    np::ndarray convertedArray(const torch::Tensor& X, torch::ScalarType target)
+    {
+        if (X.dim() != 2) {
+            throw std::runtime_error("convertedArray: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
+        }
+        auto Xn = np::empty(bp::make_tuple(X.size(1), X.size(0)), numpyDtype(target));
+        void* data = Xn.get_data();
+        {
+            // Nobody else holds Xn yet, the kernel fills it with the GIL released
+            PyGILRelease nogil;
+            transposeInto(X, target, data);
+        }
+        return Xn;
+    }
+    np::ndarray tensorView(torch::Tensor& X, np::dtype dtype)
+    {
+        // numpy [samples, features] over X's own buffer, X must be contiguous in one of its orientations
+        auto Xt = X.transpose(0, 1);
+        int64_t element_size = Xt.element_size();
+        return np::from_data(Xt.data_ptr(), dtype,
+                             bp::make_tuple(Xt.size(0), Xt.size(1)),
+                             bp::make_tuple(Xt.stride(0) * element_size, Xt.stride(1) * element_size),
+                             bp::object());
+    }
     np::ndarray tensor2numpy(torch::Tensor& X)
     {
         // Validate tensor dimensions
         if (X.dim() != 2) {
             throw std::runtime_error("tensor2numpy: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
         }
-        
-        // Ensure tensor is contiguous and in the expected format
-        auto X_copy = X.contiguous();
-        
-        if (X_copy.dtype() != torch::kFloat32) {
+        if (X.dtype() != torch::kFloat32) {
             throw std::runtime_error("tensor2numpy: Expected float32 tensor");
         }
-        
-        // Transpose from [features, samples] to [samples, features] for Python classifiers
-        X_copy = X_copy.transpose(0, 1);
-        
-        int64_t m = X_copy.size(0);
-        int64_t n = X_copy.size(1);
-        
-        // Calculate correct strides in bytes
-        int64_t element_size = X_copy.element_size();
-        int64_t stride0 = X_copy.stride(0) * element_size;
-        int64_t stride1 = X_copy.stride(1) * element_size;
-        
-        auto Xn = np::from_data(X_copy.data_ptr(), np::dtype::get_builtin<float>(), 
-                               bp::make_tuple(m, n), 
-                               bp::make_tuple(stride0, stride1), 
-                               bp::object());
-        return Xn;
+        if (!X.is_contiguous() && !isSampleMajor(X)) {
+            // A contiguous() copy would be freed on return, the array owns its copy instead
+            return convertedArray(X, torch::kFloat32);
+        }
+        return tensorView(X, np::dtype::get_builtin<float>());
+    }
+    bool isIntegerInput(const torch::Tensor& X)
+    {
+        auto type = X.scalar_type();
+        return type == torch::kUInt8 || type == torch::kInt8 || type == torch::kInt16 || type == torch::kInt32;
+    }
+    np::dtype integerDtype(const torch::Tensor& X)
+    {
+        switch (X.scalar_type()) {
+            case torch::kUInt8:
+                return np::dtype::get_builtin<uint8_t>();
+            case torch::kInt8:
+                return np::dtype::get_builtin<int8_t>();
+            case torch::kInt16:
+                return np::dtype::get_builtin<int16_t>();
+            case torch::kInt32:
+                return np::dtype::get_builtin<int32_t>();
+            default:
+                throw std::runtime_error("tensorInt2numpy: Expected uint8, int8, int16 or int32 tensor");
+        }
+    }
+    torch::ScalarType narrowestDtype(const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states)
+    {
+        size_t maxStates = 0;
+        for (const auto& feature : features) {
+            auto item = states.find(feature);
+            if (item == states.end()) {
+                return torch::kInt32;
+            }
+            maxStates = std::max(maxStates, item->second.size());
+        }
+        if (maxStates <= 256) {
+            return torch::kUInt8;
+        }
+        if (maxStates <= 32768) {
+            return torch::kInt16;
+        }
+        return torch::kInt32;
     }
     np::ndarray tensorInt2numpy(torch::Tensor& X)
     {
@@ -50,32 +132,13 @@ namespace pywrap {
         if (X.dim() != 2) {
             throw std::runtime_error("tensorInt2numpy: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
         }
-        
-        // Ensure tensor is contiguous and in the expected format
-        auto X_copy = X.contiguous();
-        
-        if (X_copy.dtype() != torch::kInt32) {
-            throw std::runtime_error("tensorInt2numpy: Expected int32 tensor");
+        auto dtype = integerDtype(X);
+        if (!X.is_contiguous() && !isSampleMajor(X)) {
+            return convertedArray(X, X.scalar_type());
         }
-        
-        // Transpose from [features, samples] to [samples, features] for Python classifiers
-        X_copy = X_copy.transpose(0, 1);
-        
-        int64_t m = X_copy.size(0);
-        int64_t n = X_copy.size(1);
-        
-        // Calculate correct strides in bytes
-        int64_t element_size = X_copy.element_size();
-        int64_t stride0 = X_copy.stride(0) * element_size;
-        int64_t stride1 = X_copy.stride(1) * element_size;
-        
-        auto Xn = np::from_data(X_copy.data_ptr(), np::dtype::get_builtin<int>(), 
-                               bp::make_tuple(m, n), 
-                               bp::make_tuple(stride0, stride1), 
-                               bp::object());
-        return Xn;
+        return tensorView(X, dtype);
     }
-    std::pair<np::ndarray, np::ndarray> tensors2numpy(torch::Tensor& X, torch::Tensor& y)
+    np::ndarray labels2numpy(torch::Tensor& y, int64_t samples)
     {
         // Validate y tensor dimensions
         if (y.dim() != 1) {
@@ -83,10 +146,9 @@ namespace pywrap {
         }
         
         // Validate dimensions match (X is [features, samples], y is [samples])
-        // X.size(1) is samples, y.size(0) is samples
-        if (X.size(1) != y.size(0)) {
+        if (samples != y.size(0)) {
             throw std::runtime_error("tensors2numpy: X and y dimension mismatch: X[" + 
-                                   std::to_string(X.size(1)) + "], y[" + std::to_string(y.size(0)) + "]");
+                                   std::to_string(samples) + "], y[" + std::to_string(y.size(0)) + "]");
         }
         
         // Ensure y tensor is contiguous
@@ -100,16 +162,128 @@ namespace pywrap {
         int64_t element_size = y.element_size();
         int64_t stride = y.stride(0) * element_size;
         
-        auto yn = np::from_data(y.data_ptr(), np::dtype::get_builtin<int32_t>(), 
-                               bp::make_tuple(n), 
-                               bp::make_tuple(stride), 
-                               bp::object());
-        
-        if (X.dtype() == torch::kInt32) {
+        return np::from_data(y.data_ptr(), np::dtype::get_builtin<int32_t>(), 
+                             bp::make_tuple(n), 
+                             bp::make_tuple(stride), 
+                             bp::object());
+    }
+    std::pair<np::ndarray, np::ndarray> tensors2numpy(torch::Tensor& X, torch::Tensor& y)
+    {
+        // X.size(1) is samples, y.size(0) is samples
+        auto yn = labels2numpy(y, X.size(1));
+        if (isIntegerInput(X)) {
             return { tensorInt2numpy(X), yn };
         }
         return { tensor2numpy(X), yn };
     }
+    bool isSparseInput(const torch::Tensor& X)
+    {
+        return X.is_sparse() || X.layout() == torch::kSparseCsr || X.layout() == torch::kSparseCsc;
+    }
+    np::ndarray buffer2numpy(const torch::Tensor& buffer)
+    {
+        // Zero copy view of a 1D index or value buffer of a sparse tensor
+        np::dtype dtype = np::dtype::get_builtin<double>();
+        switch (buffer.scalar_type()) {
+            case torch::kInt32:
+                dtype = np::dtype::get_builtin<int32_t>();
+                break;
+            case torch::kInt64:
+                dtype = np::dtype::get_builtin<int64_t>();
+                break;
+            case torch::kFloat32:
+                dtype = np::dtype::get_builtin<float>();
+                break;
+            case torch::kFloat64:
+                break;
+            default:
+                throw std::runtime_error("sparse2scipy: unexpected buffer data type");
+        }
+        return np::from_data(buffer.data_ptr(), dtype,
+                             bp::make_tuple(buffer.size(0)),
+                             bp::make_tuple(buffer.stride(0) * buffer.element_size()),
+                             bp::object());
+    }
+    CPyObject sparse2scipy(torch::Tensor& X, std::vector<torch::Tensor>& buffers)
+    {
+        // X is a sparse [features, samples] tensor, scipy gets [samples, features] over the same buffers.
+        // buffers keeps alive whatever the views point to until the Python call is done
+        if (X.dim() != 2) {
+            throw std::runtime_error("sparse2scipy: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
+        }
+        auto values = [&buffers](torch::Tensor v) {
+            if (v.scalar_type() != torch::kFloat32 && v.scalar_type() != torch::kFloat64) {
+                v = v.to(torch::kFloat64);
+            }
+            buffers.push_back(v.contiguous());
+            return bp::object(buffer2numpy(buffers.back()));
+        };
+        auto indices = [&buffers](const torch::Tensor& i) {
+            buffers.push_back(i.contiguous());
+            return bp::object(buffer2numpy(buffers.back()));
+        };
+        auto shape = bp::make_tuple(X.size(1), X.size(0));
+        auto sparse = bp::import("scipy.sparse");
+        bp::object matrix;
+        if (X.layout() == torch::kSparseCsc) {
+            // Compressed feature-major columns are compressed sample-major rows: CSR as it is
+            matrix = sparse.attr("csr_matrix")(bp::make_tuple(values(X.values()), indices(X.row_indices()), indices(X.ccol_indices())), shape);
+        } else if (X.layout() == torch::kSparseCsr) {
+            // Compressed feature rows are compressed columns of the sample-major matrix
+            matrix = sparse.attr("csc_matrix")(bp::make_tuple(values(X.values()), indices(X.col_indices()), indices(X.crow_indices())), shape);
+        } else {
+            // COO: scipy builds the CSR from the coordinate views
+            auto coalesced = X.coalesce();
+            auto coordinates = coalesced.indices();
+            auto coo = sparse.attr("coo_matrix")(bp::make_tuple(values(coalesced.values()), bp::make_tuple(indices(coordinates[1]), indices(coordinates[0]))), shape);
+            matrix = coo.attr("tocsr")();
+        }
+        return bp::incref(matrix.ptr());
+    }
+    np::ndarray vectors2numpy(std::vector<std::vector<int>>& X)
+    {
+        // X is [features][samples], numpy gets [samples, features] filled in one pass
+        if (X.empty() || X[0].empty()) {
+            throw std::runtime_error("vectors2numpy: Expected non empty X");
+        }
+        int64_t n = X.size();
+        int64_t m = X[0].size();
+        auto Xn = np::empty(bp::make_tuple(m, n), np::dtype::get_builtin<int32_t>());
+        int32_t* data = reinterpret_cast<int32_t*>(Xn.get_data());
+        for (int64_t feature = 0; feature < n; ++feature) {
+            if (static_cast<int64_t>(X[feature].size()) != m) {
+                throw std::runtime_error("vectors2numpy: Feature " + std::to_string(feature) + " has " + std::to_string(X[feature].size()) + " samples, expected " + std::to_string(m));
+            }
+            const int* column = X[feature].data();
+            for (int64_t sample = 0; sample < m; ++sample) {
+                data[sample * n + feature] = column[sample];
+            }
+        }
+        return Xn;
+    }
+    torch::Tensor vectorsTensor(const std::vector<std::vector<int>>& X)
+    {
+        // [features][samples] copied into an int32 [features, samples] tensor, for the paths that need one
+        if (X.empty() || X[0].empty()) {
+            throw std::runtime_error("vectorsTensor: Expected non empty X");
+        }
+        auto tensor = torch::empty({ static_cast<int64_t>(X.size()), static_cast<int64_t>(X[0].size()) }, torch::kInt32);
+        for (size_t feature = 0; feature < X.size(); ++feature) {
+            if (X[feature].size() != X[0].size()) {
+                throw std::runtime_error("vectorsTensor: Feature " + std::to_string(feature) + " has " + std::to_string(X[feature].size()) + " samples, expected " + std::to_string(X[0].size()));
+            }
+            std::copy(X[feature].begin(), X[feature].end(), tensor[feature].data_ptr<int32_t>());
+        }
+        return tensor;
+    }
+    np::ndarray vector2numpy(std::vector<int>& y)
+    {
+        // Zero copy view, only valid while y is alive
+        return np::from_data(y.data(), np::dtype::get_builtin<int32_t>(),
+                             bp::make_tuple(y.size()),
+                             bp::make_tuple(sizeof(int32_t)),
+                             bp::object());
+    }
     std::string PyClassifier::version()
     {
         if (sklearn) {
@@ -131,17 +305,47 @@ namespace pywrap {
     }
     PyClassifier& PyClassifier::fit(torch::Tensor& X, torch::Tensor& y)
     {
-        if (!fitted && hyperparameters.size() > 0) {
-            pyWrap->setHyperparameters(id, hyperparameters);
+        return fitInput(X, y, true, [this](CPyObject& Xp, CPyObject& yp) { pyWrap->fit(id, Xp, yp); });
+    }
+    PyClassifier& PyClassifier::fitInput(torch::Tensor& X, torch::Tensor& y, bool refit, const std::function<void(CPyObject&, CPyObject&)>& call)
+    {
+        if (refit) {
+            applyHyperparameters();
+        }
+        PlacementScope pin(placement);
+        if (pin.active()) {
+            pinnedCalls++;
         }
+        if (refit && !preprocessing.empty()) {
+            preprocessing.fit(X, y);
+        }
+        std::vector<torch::Tensor> buffers;
+        // numpy conversions touch Python objects, they also need the GIL
+        PyGILGuard gil;
         try {
-            auto [Xn, yn] = tensors2numpy(X, y);
-            CPyObject Xp = bp::incref(bp::object(Xn).ptr());
-            CPyObject yp = bp::incref(bp::object(yn).ptr());
-            pyWrap->fit(id, Xp, yp);
+            if (refit && !preprocessing.empty()) {
+                // Arrays converted by the previous parameters
+                conversions.clear();
+            }
+            CPyObject yp = bp::incref(bp::object(labels2numpy(y, X.size(1))).ptr());
+            CPyObject Xp = inputArray(X, buffers);
+            call(Xp, yp);
             fitted = true;
+            metadata = pyWrap->modelMetadata(id);
+            if (!preprocessing.empty()) {
+                metadata["preprocessing"] = preprocessing.toJson();
+            }
+            makeReplicas();
+            if (refit && (nFeatures != X.size(0) || !preprocessing.empty())) {
+                resetRowPath();
+                nFeatures = X.size(0);
+            }
             return *this;
         }
+        catch (const PyCancelledException&) {
+            fitStopped();
+            throw;
+        }
         catch (const std::exception& e) {
             // Clear any Python errors before re-throwing
             if (PyErr_Occurred()) {
@@ -150,66 +354,121 @@ namespace pywrap {
             throw;
         }
     }
+    torch::Tensor narrowedInput(torch::Tensor& X, const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states)
+    {
+        if (isIntegerInput(X) && !features.empty() && X.dim() == 2 && !X.is_sparse()) {
+            // Discretized data: hand Python the narrowest width the states allow. One pass narrows X
+            // sample major, as the estimator takes it, and checks the values against the width
+            auto narrow = narrowestDtype(features, states);
+            if (c10::elementSize(narrow) < X.element_size()) {
+                auto Xn = torch::empty({ X.size(1), X.size(0) }, X.options().dtype(narrow));
+                if (narrowInto(X, narrow, Xn.data_ptr())) {
+                    return Xn.t();
+                }
+            }
+        }
+        return X;
+    }
     PyClassifier& PyClassifier::fit(torch::Tensor& X, torch::Tensor& y, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing)
     {
-        return fit(X, y);
+        // Only integer X holds the state codes, float X with states is left to the estimator as it is
+        prepareStates(features, isIntegerInput(X) ? states : std::map<std::string, std::vector<int>>());
+        auto Xn = narrowedInput(X, features, states);
+        return fit(Xn, y);
     }
-    torch::Tensor PyClassifier::predict(torch::Tensor& X)
+    std::pair<torch::Tensor, torch::Tensor> splitDataset(torch::Tensor& dataset)
     {
-        try {
-            CPyObject Xp;
-            if (X.dtype() == torch::kInt32) {
-                auto Xn = tensorInt2numpy(X);
-                Xp = bp::incref(bp::object(Xn).ptr());
-            } else {
-                auto Xn = tensor2numpy(X);
-                Xp = bp::incref(bp::object(Xn).ptr());
-            }
-            
-            // Use RAII guard for automatic cleanup
-            PyObjectGuard incoming(pyWrap->predict(id, Xp));
-            if (!incoming) {
-                throw std::runtime_error("predict() returned NULL for " + module + ":" + className);
-            }
-            
-            bp::handle<> handle(incoming.release());  // Transfer ownership to boost
-            bp::object object(handle);
-            np::ndarray prediction = np::from_object(object);
-            
-            if (PyErr_Occurred()) {
-                PyErr_Clear();
-                throw std::runtime_error("Error creating numpy object for predict in " + module + ":" + className);
-            }
-            
-            // Validate numpy array
-            if (prediction.get_nd() != 1) {
-                throw std::runtime_error("Expected 1D prediction array, got " + std::to_string(prediction.get_nd()) + "D");
-            }
-            
-            // Safe type conversion with validation
-            std::vector<int> vPrediction;
-            if (xgboost) {
-                // Validate data type for XGBoost (typically returns long)
-                if (prediction.get_dtype() == np::dtype::get_builtin<long>()) {
-                    long* data = reinterpret_cast<long*>(prediction.get_data());
-                    vPrediction.reserve(prediction.shape(0));
-                    for (int i = 0; i < prediction.shape(0); ++i) {
-                        vPrediction.push_back(static_cast<int>(data[i]));
-                    }
-                } else {
-                    throw std::runtime_error("XGBoost prediction: unexpected data type");
+        if (dataset.dim() != 2 || dataset.size(0) < 2) {
+            throw std::runtime_error("splitDataset: Expected [features + 1, samples] dataset");
+        }
+        // Row slices of the dataset, no copy when it is contiguous
+        auto n = dataset.size(0) - 1;
+        auto X = dataset.slice(0, 0, n);
+        auto y = dataset.select(0, n);
+        if (y.dtype() != torch::kInt32) {
+            y = y.to(torch::kInt32);
+        }
+        return { X, y };
+    }
+    PyClassifier& PyClassifier::fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing)
+    {
+        auto [X, y] = splitDataset(dataset);
+        return fit(X, y, features, className, states, smoothing);
+    }
+    PyClassifier& PyClassifier::fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const torch::Tensor& weights, const bayesnet::Smoothing_t smoothing)
+    {
+        auto [X, y] = splitDataset(dataset);
+        if (weights.dim() != 1 || weights.size(0) != y.size(0)) {
+            throw std::runtime_error("fit: Expected weights of size " + std::to_string(y.size(0)));
+        }
+        auto w = weights.dtype() == torch::kFloat64 ? weights.contiguous() : weights.to(torch::kFloat64).contiguous();
+        // Same states handling and narrowing as the unweighted fit
+        prepareStates(features, isIntegerInput(X) ? states : std::map<std::string, std::vector<int>>());
+        auto Xn = narrowedInput(X, features, states);
+        return fitInput(Xn, y, true, [this, &w](CPyObject& Xp, CPyObject& yp) {
+            auto wn = np::from_data(w.data_ptr(), np::dtype::get_builtin<double>(),
+                                    bp::make_tuple(w.size(0)),
+                                    bp::make_tuple(w.stride(0) * w.element_size()),
+                                    bp::object());
+            CPyObject wp = bp::incref(bp::object(wn).ptr());
+            pyWrap->fitWeighted(id, Xp, yp, wp);
+        });
+    }
+    PyClassifier& PyClassifier::extend(torch::Tensor& X, torch::Tensor& y, int n)
+    {
+        if (growth == Growth::None) {
+            throw PyUnsupportedException(module + ":" + className + " can't grow a fitted model, fit it again instead");
+        }
+        if (n < 1) {
+            throw std::invalid_argument("extend: n must be >= 1");
+        }
+        if (!fitted) {
+            throw std::runtime_error("extend: " + className + " is not fitted");
+        }
+        if (X.dim() != 2 || X.size(0) != nFeatures) {
+            throw std::runtime_error("extend: expected X [" + std::to_string(nFeatures) + ", samples]");
+        }
+        auto current = metadataInt("n_estimators");
+        // The pipeline isn't refitted: the new estimators see the features the others saw
+        return fitInput(X, y, false, [this, current, n](CPyObject& Xp, CPyObject& yp) {
+            if (growth == Growth::WarmStart) {
+                setAttributes({ { "warm_start", true }, { "n_estimators", current + n } });
+                try {
+                    pyWrap->fit(id, Xp, yp);
+                }
+                catch (...) {
+                    setAttributes({ { "warm_start", false }, { "n_estimators", current } });
+                    throw;
                 }
+                // Later fits start from zero again
+                setAttributes({ { "warm_start", false } });
             } else {
-                // Validate data type for other classifiers (typically returns int)
-                if (prediction.get_dtype() == np::dtype::get_builtin<int>()) {
-                    int* data = reinterpret_cast<int*>(prediction.get_data());
-                    vPrediction.assign(data, data + prediction.shape(0));
-                } else {
-                    throw std::runtime_error("Prediction: unexpected data type");
+                setAttributes({ { "n_estimators", n } });
+                try {
+                    pyWrap->fitContinued(id, Xp, yp);
                 }
+                catch (...) {
+                    setAttributes({ { "n_estimators", current } });
+                    throw;
+                }
+                // A later fit trains as many rounds as the model has
+                setAttributes({ { "n_estimators", current + n } });
             }
-            
-            return torch::tensor(vPrediction, torch::kInt32);
+        });
+    }
+    torch::Tensor PyClassifier::predict(torch::Tensor& X)
+    {
+        ReplicaLease lease(*this);
+        PlacementScope pin(placement);
+        if (pin.active()) {
+            pinnedCalls++;
+        }
+        std::vector<torch::Tensor> buffers;
+        PyGILGuard gil;
+        try {
+            CPyObject Xp = inputArray(X, buffers);
+            auto prediction = resultArray(pyWrap->predict(lease.id(), Xp), "predict", 1);
+            return torch::tensor(predictionsVector(prediction), torch::kInt32);
         }
         catch (const std::exception& e) {
             // Clear any Python errors before re-throwing
@@ -221,60 +480,434 @@ namespace pywrap {
     }
     torch::Tensor PyClassifier::predict_proba(torch::Tensor& X)
     {
+        ReplicaLease lease(*this);
+        PlacementScope pin(placement);
+        if (pin.active()) {
+            pinnedCalls++;
+        }
+        std::vector<torch::Tensor> buffers;
+        PyGILGuard gil;
         try {
-            CPyObject Xp;
-            if (X.dtype() == torch::kInt32) {
-                auto Xn = tensorInt2numpy(X);
-                Xp = bp::incref(bp::object(Xn).ptr());
-            } else {
-                auto Xn = tensor2numpy(X);
-                Xp = bp::incref(bp::object(Xn).ptr());
-            }
-            
-            // Use RAII guard for automatic cleanup
-            PyObjectGuard incoming(pyWrap->predict_proba(id, Xp));
-            if (!incoming) {
-                throw std::runtime_error("predict_proba() returned NULL for " + module + ":" + className);
-            }
-            
-            bp::handle<> handle(incoming.release());  // Transfer ownership to boost
-            bp::object object(handle);
-            np::ndarray prediction = np::from_object(object);
-            
+            CPyObject Xp = inputArray(X, buffers);
+            auto prediction = resultArray(pyWrap->predict_proba(lease.id(), Xp), "predict_proba", 2);
+            return probabilitiesTensor(prediction);
+        }
+        catch (const std::exception& e) {
+            // Clear any Python errors before re-throwing
             if (PyErr_Occurred()) {
                 PyErr_Clear();
-                throw std::runtime_error("Error creating numpy object for predict_proba in " + module + ":" + className);
             }
-            
-            // Validate numpy array dimensions
-            if (prediction.get_nd() != 2) {
-                throw std::runtime_error("Expected 2D probability array, got " + std::to_string(prediction.get_nd()) + "D");
+            throw;
+        }
+    }
+    torch::Tensor PyClassifier::probabilitiesTensor(np::ndarray& prediction)
+    {
+        int64_t rows = prediction.shape(0);
+        int64_t cols = prediction.shape(1);
+        
+        // Safe type conversion with validation
+        if (xgboost) {
+            // Validate data type for XGBoost (typically returns float)
+            if (prediction.get_dtype() == np::dtype::get_builtin<float>()) {
+                float* data = reinterpret_cast<float*>(prediction.get_data());
+                std::vector<float> vPrediction(data, data + rows * cols);
+                return torch::tensor(vPrediction, torch::kFloat32).reshape({rows, cols});
+            } else {
+                throw std::runtime_error("XGBoost predict_proba: unexpected data type");
             }
-            
-            int64_t rows = prediction.shape(0);
-            int64_t cols = prediction.shape(1);
-            
-            // Safe type conversion with validation
-            if (xgboost) {
-                // Validate data type for XGBoost (typically returns float)
-                if (prediction.get_dtype() == np::dtype::get_builtin<float>()) {
-                    float* data = reinterpret_cast<float*>(prediction.get_data());
-                    std::vector<float> vPrediction(data, data + rows * cols);
-                    return torch::tensor(vPrediction, torch::kFloat32).reshape({rows, cols});
-                } else {
-                    throw std::runtime_error("XGBoost predict_proba: unexpected data type");
-                }
+        } else {
+            // Validate data type for other classifiers (typically returns double)
+            if (prediction.get_dtype() == np::dtype::get_builtin<double>()) {
+                double* data = reinterpret_cast<double*>(prediction.get_data());
+                std::vector<double> vPrediction(data, data + rows * cols);
+                return torch::tensor(vPrediction, torch::kFloat64).reshape({rows, cols});
             } else {
-                // Validate data type for other classifiers (typically returns double)
-                if (prediction.get_dtype() == np::dtype::get_builtin<double>()) {
-                    double* data = reinterpret_cast<double*>(prediction.get_data());
-                    std::vector<double> vPrediction(data, data + rows * cols);
-                    return torch::tensor(vPrediction, torch::kFloat64).reshape({rows, cols});
+                throw std::runtime_error("predict_proba: unexpected data type");
+            }
+        }
+    }
+    int64_t PyClassifier::predictStream(ChunkSource& source, PredictionSink& sink, int64_t chunkRows, bool probabilities)
+    {
+        auto features = source.features();
+        if (chunkRows <= 0) {
+            throw std::invalid_argument("predictStream: chunkRows must be > 0");
+        }
+        if (nFeatures != 0 && features != nFeatures) {
+            throw std::runtime_error("predictStream: the source has " + std::to_string(features) + " features, the model " + std::to_string(nFeatures));
+        }
+        // Two slots: the reader thread fills and converts one while the estimator predicts the other
+        struct Slot {
+            torch::Tensor rows; // [chunkRows, features] float32, as the source writes them
+            CPyObject array; // [chunkRows, features] of inputDtype handed to the estimator
+            void* data = nullptr; // array's buffer when it isn't a view of rows
+            int64_t count = 0;
+            bool ready = false;
+        };
+        std::array<Slot, 2> slots;
+        auto releaseArrays = [&slots]() {
+            PyGILGuard gil;
+            for (auto& slot : slots) {
+                slot.array.Release();
+            }
+        };
+        {
+            PyGILGuard gil;
+            for (auto& slot : slots) {
+                slot.rows = torch::empty({ chunkRows, features }, torch::kFloat32);
+                if (inputDtype == torch::kFloat32 && preprocessing.empty()) {
+                    // The estimator computes on float32: it reads the rows in place
+                    auto view = np::from_data(slot.rows.data_ptr(), np::dtype::get_builtin<float>(),
+                                              bp::make_tuple(chunkRows, features),
+                                              bp::make_tuple(features * sizeof(float), sizeof(float)),
+                                              bp::object());
+                    slot.array = bp::incref(bp::object(view).ptr());
                 } else {
-                    throw std::runtime_error("predict_proba: unexpected data type");
+                    auto array = np::empty(bp::make_tuple(chunkRows, modelFeatures()), numpyDtype(inputDtype));
+                    slot.data = array.get_data();
+                    slot.array = bp::incref(bp::object(array).ptr());
                 }
             }
         }
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool stop = false;
+        std::exception_ptr readError;
+        std::thread reader([&]() {
+            try {
+                for (int next = 0; ; next ^= 1) {
+                    auto& slot = slots[next];
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        changed.wait(lock, [&]() { return !slot.ready || stop; });
+                        if (stop) {
+                            return;
+                        }
+                    }
+                    auto count = source.read(slot.rows.data_ptr<float>(), chunkRows);
+                    if (count > 0 && slot.data != nullptr) {
+                        convertInto(slot.rows.narrow(0, 0, count).t(), slot.data);
+                    }
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        slot.count = count;
+                        slot.ready = true;
+                    }
+                    changed.notify_all();
+                    if (count == 0) {
+                        return;
+                    }
+                }
+            }
+            catch (...) {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    readError = std::current_exception();
+                }
+                changed.notify_all();
+            }
+        });
+        int64_t total = 0;
+        try {
+            PlacementScope pin(placement);
+            for (int current = 0; ; current ^= 1) {
+                auto& slot = slots[current];
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return slot.ready || readError; });
+                    if (!slot.ready) {
+                        std::rethrow_exception(readError);
+                    }
+                }
+                if (slot.count == 0) {
+                    break;
+                }
+                torch::Tensor result;
+                {
+                    ReplicaLease lease(*this);
+                    PyGILGuard gil;
+                    CPyObject Xp;
+                    if (slot.count == chunkRows) {
+                        Xp = slot.array;
+                    } else {
+                        // The last chunk is usually shorter, the estimator gets the rows read
+                        Xp = PySequence_GetSlice(slot.array, 0, slot.count);
+                        if (!Xp) {
+                            PyErr_Clear();
+                            throw std::runtime_error("predictStream: couldn't slice the last chunk");
+                        }
+                    }
+                    if (probabilities) {
+                        auto prediction = resultArray(pyWrap->predict_proba(lease.id(), Xp), "predict_proba", 2);
+                        result = probabilitiesTensor(prediction);
+                    } else {
+                        auto prediction = resultArray(pyWrap->predict(lease.id(), Xp), "predict", 1);
+                        result = torch::tensor(predictionsVector(prediction), torch::kInt32);
+                    }
+                }
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slot.ready = false;
+                }
+                changed.notify_all();
+                sink.write(result);
+                total += result.size(0);
+            }
+        }
+        catch (...) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            changed.notify_all();
+            reader.join();
+            releaseArrays();
+            throw;
+        }
+        reader.join();
+        releaseArrays();
+        return total;
+    }
+    float PyClassifier::score(torch::Tensor& X, torch::Tensor& y)
+    {
+        // One predict, the accuracy is counted in C++ instead of by the estimator's score
+        auto prediction = predict(X);
+        return static_cast<float>(accuracy(y, prediction));
+    }
+    nlohmann::json PyClassifier::evaluate(torch::Tensor& X, torch::Tensor& y, const std::vector<std::string>& metrics)
+    {
+        std::vector<int> classes;
+        auto known = metadata.find("classes");
+        if (known != metadata.end() && known->is_array() && std::all_of(known->begin(), known->end(), [](const nlohmann::json& label) { return label.is_number_integer(); })) {
+            classes = known->get<std::vector<int>>();
+        }
+        if (!needsProbabilities(metrics)) {
+            auto predictions = predict(X);
+            return computeMetrics(metrics, y, predictions, torch::Tensor(), classes);
+        }
+        // The estimator runs once: the labels are the most probable classes
+        auto probabilities = predict_proba(X);
+        if (classes.empty()) {
+            classes.resize(probabilities.size(1));
+            std::iota(classes.begin(), classes.end(), 0);
+        }
+        auto predictions = torch::tensor(classes, torch::kInt64).index_select(0, probabilities.argmax(1));
+        return computeMetrics(metrics, y, predictions, probabilities, classes);
+    }
+    void PyClassifier::setHyperparameters(const nlohmann::json& hyperparameters)
+    {
+        // The pipeline is ours, the estimator never sees it
+        auto values = hyperparameters;
+        if (values.is_object() && values.contains("preprocessing")) {
+            setPreprocessing(Preprocessing(values["preprocessing"]));
+            values.erase("preprocessing");
+        }
+        this->hyperparameters = values;
+    }
+    void PyClassifier::applyHyperparameters()
+    {
+        if (!fitted && hyperparameters.size() > 0) {
+            pyWrap->setHyperparameters(id, hyperparameters);
+        }
+    }
+    void PyClassifier::replicate(int n, CloneMode mode)
+    {
+        if (n < 0) {
+            throw std::invalid_argument("replicate: n must be >= 0");
+        }
+        auto lock = lockReplicas();
+        for (auto& replica : replicas) {
+            pyWrap->clean(replica->id);
+        }
+        replicas.clear();
+        replicaMode = mode;
+        for (int i = 0; i < n; ++i) {
+            auto replica = std::make_unique<Replica>();
+            // Like the classifier itself, the replica's address is its registry id
+            replica->id = reinterpret_cast<clfId_t>(replica.get());
+            if (fitted) {
+                pyWrap->cloneClass(id, replica->id, replicaMode);
+            }
+            replicas.push_back(std::move(replica));
+        }
+    }
+    std::unique_lock<std::shared_mutex> PyClassifier::lockReplicas()
+    {
+        std::unique_lock<std::shared_mutex> lock(replicaMutex, std::defer_lock);
+        if (PyGILState_Check()) {
+            PyGILRelease nogil;
+            lock.lock();
+        } else {
+            lock.lock();
+        }
+        return lock;
+    }
+    void PyClassifier::makeReplicas()
+    {
+        // Copies of the current model under the replicas' ids, the stale ones go first
+        auto lock = lockReplicas();
+        for (auto& replica : replicas) {
+            pyWrap->clean(replica->id);
+            pyWrap->cloneClass(id, replica->id, replicaMode);
+        }
+    }
+    void PyClassifier::fitStopped()
+    {
+        // PyWrap put an unfitted estimator in place of the stopped one, the replicas follow it
+        fitted = false;
+        metadata = nlohmann::json();
+        resetRowPath();
+        nFeatures = 0;
+        makeReplicas();
+    }
+    void PyClassifier::dropReplicas()
+    {
+        auto lock = lockReplicas();
+        for (auto& replica : replicas) {
+            pyWrap->clean(replica->id);
+        }
+        replicas.clear();
+    }
+    PyClassifier::Replica& PyClassifier::leastBusy()
+    {
+        if (replicas.empty()) {
+            return primary;
+        }
+        // Round robin start, so equally busy copies take turns
+        auto count = replicas.size() + 1;
+        auto start = nextReplica++ % count;
+        Replica* best = nullptr;
+        for (size_t i = 0; i < count; ++i) {
+            auto index = (start + i) % count;
+            Replica* candidate = index == 0 ? &primary : replicas[index - 1].get();
+            if (best == nullptr || candidate->inFlight < best->inFlight) {
+                best = candidate;
+            }
+        }
+        return *best;
+    }
+    int PyClassifier::metadataInt(const std::string& key) const
+    {
+        auto item = metadata.find(key);
+        return item != metadata.end() && item->is_number_integer() ? item->get<int>() : 0;
+    }
+    void PyClassifier::setAttributes(const nlohmann::json& attributes)
+    {
+        pyWrap->setHyperparameters(id, attributes);
+    }
+    void PyClassifier::setPlacement(const Placement& placement)
+    {
+        this->placement = placement;
+        notes.erase(std::remove_if(notes.begin(), notes.end(), [](const std::string& note) { return note.rfind("Placement:", 0) == 0; }), notes.end());
+        if (!placement.empty()) {
+            notes.push_back(placement.toString());
+        }
+    }
+    nlohmann::json PyClassifier::placementReport() const
+    {
+        auto report = placement.toJson();
+        report["pinned_calls"] = pinnedCalls.load();
+        report["node_local_bytes"] = nodeLocalBytes.load();
+        return report;
+    }
+    np::ndarray PyClassifier::localArray(int64_t rows, int64_t cols)
+    {
+        auto Xn = np::empty(bp::make_tuple(rows, cols), numpyDtype(inputDtype));
+        auto current = PlacementScope::current();
+        if (current == nullptr || current->getNode() < 0) {
+            return Xn;
+        }
+        // A page lives on the node of the cpu touching it first: this pinned thread, not the
+        // intra-op pool the conversion kernels fill it from. Every 4KiB covers larger pages too
+        size_t bytes = rows * cols * c10::elementSize(inputDtype);
+        auto data = static_cast<volatile char*>(Xn.get_data());
+        for (size_t offset = 0; offset < bytes; offset += 4096) {
+            data[offset] = 0;
+        }
+        nodeLocalBytes += bytes;
+        return Xn;
+    }
+    np::ndarray PyClassifier::resultArray(PyObject* result, const std::string& method, int dimensions)
+    {
+        // Use RAII guard for automatic cleanup
+        PyObjectGuard incoming(result);
+        if (!incoming) {
+            throw std::runtime_error(method + "() returned NULL for " + module + ":" + className);
+        }
+        
+        bp::handle<> handle(incoming.release());  // Transfer ownership to boost
+        bp::object object(handle);
+        np::ndarray array = np::from_object(object);
+        
+        if (PyErr_Occurred()) {
+            PyErr_Clear();
+            throw std::runtime_error("Error creating numpy object for " + method + " in " + module + ":" + className);
+        }
+        
+        // Validate numpy array dimensions
+        if (array.get_nd() != dimensions) {
+            throw std::runtime_error("Expected " + std::to_string(dimensions) + "D " + method + " array, got " + std::to_string(array.get_nd()) + "D");
+        }
+        return array;
+    }
+    std::vector<int> PyClassifier::predictionsVector(np::ndarray& prediction)
+    {
+        // Safe type conversion with validation
+        std::vector<int> vPrediction;
+        if (xgboost) {
+            // Validate data type for XGBoost (typically returns long)
+            if (prediction.get_dtype() == np::dtype::get_builtin<long>()) {
+                long* data = reinterpret_cast<long*>(prediction.get_data());
+                vPrediction.reserve(prediction.shape(0));
+                for (int i = 0; i < prediction.shape(0); ++i) {
+                    vPrediction.push_back(static_cast<int>(data[i]));
+                }
+            } else {
+                throw std::runtime_error("XGBoost prediction: unexpected data type");
+            }
+        } else {
+            // Validate data type for other classifiers (typically returns int)
+            if (prediction.get_dtype() == np::dtype::get_builtin<int>()) {
+                int* data = reinterpret_cast<int*>(prediction.get_data());
+                vPrediction.assign(data, data + prediction.shape(0));
+            } else {
+                throw std::runtime_error("Prediction: unexpected data type");
+            }
+        }
+        return vPrediction;
+    }
+    PyClassifier& PyClassifier::fit(std::vector<std::vector<int>>& X, std::vector<int>& y, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing)
+    {
+        if (X.empty() || X[0].size() != y.size()) {
+            throw std::runtime_error("fit: X and y dimension mismatch");
+        }
+        if (!preprocessing.empty()) {
+            // The pipeline runs on tensors
+            auto Xt = vectorsTensor(X);
+            auto yt = torch::tensor(y, torch::kInt32);
+            fit(Xt, yt, features, className, states, smoothing);
+            return *this;
+        }
+        prepareStates(features, states);
+        applyHyperparameters();
+        PlacementScope pin(placement);
+        PyGILGuard gil;
+        try {
+            CPyObject Xp = bp::incref(bp::object(vectors2numpy(X)).ptr());
+            CPyObject yp = bp::incref(bp::object(vector2numpy(y)).ptr());
+            pyWrap->fit(id, Xp, yp);
+            fitted = true;
+            metadata = pyWrap->modelMetadata(id);
+            makeReplicas();
+            if (nFeatures != static_cast<int64_t>(X.size())) {
+                resetRowPath();
+                nFeatures = X.size();
+            }
+            return *this;
+        }
+        catch (const PyCancelledException&) {
+            fitStopped();
+            throw;
+        }
         catch (const std::exception& e) {
             // Clear any Python errors before re-throwing
             if (PyErr_Occurred()) {
@@ -283,13 +916,20 @@ namespace pywrap {
             throw;
         }
     }
-    float PyClassifier::score(torch::Tensor& X, torch::Tensor& y)
+    std::vector<int> PyClassifier::predict(std::vector<std::vector<int>>& X)
     {
+        if (!preprocessing.empty()) {
+            auto Xt = vectorsTensor(X);
+            auto prediction = predict(Xt).contiguous();
+            return std::vector<int>(prediction.data_ptr<int32_t>(), prediction.data_ptr<int32_t>() + prediction.numel());
+        }
+        ReplicaLease lease(*this);
+        PlacementScope pin(placement);
+        PyGILGuard gil;
         try {
-            auto [Xn, yn] = tensors2numpy(X, y);
-            CPyObject Xp = bp::incref(bp::object(Xn).ptr());
-            CPyObject yp = bp::incref(bp::object(yn).ptr());
-            return pyWrap->score(id, Xp, yp);
+            CPyObject Xp = bp::incref(bp::object(vectors2numpy(X)).ptr());
+            auto prediction = resultArray(pyWrap->predict(lease.id(), Xp), "predict", 1);
+            return predictionsVector(prediction);
         }
         catch (const std::exception& e) {
             // Clear any Python errors before re-throwing
@@ -299,8 +939,228 @@ namespace pywrap {
             throw;
         }
     }
-    void PyClassifier::setHyperparameters(const nlohmann::json& hyperparameters)
+    std::vector<std::vector<double>> PyClassifier::predict_proba(std::vector<std::vector<int>>& X)
+    {
+        if (!preprocessing.empty()) {
+            auto Xt = vectorsTensor(X);
+            auto probabilities = predict_proba(Xt).to(torch::kFloat64).contiguous();
+            std::vector<std::vector<double>> rows(probabilities.size(0));
+            const double* data = probabilities.data_ptr<double>();
+            for (int64_t row = 0; row < probabilities.size(0); ++row) {
+                rows[row].assign(data + row * probabilities.size(1), data + (row + 1) * probabilities.size(1));
+            }
+            return rows;
+        }
+        ReplicaLease lease(*this);
+        PlacementScope pin(placement);
+        PyGILGuard gil;
+        try {
+            CPyObject Xp = bp::incref(bp::object(vectors2numpy(X)).ptr());
+            auto prediction = resultArray(pyWrap->predict_proba(lease.id(), Xp), "predict_proba", 2);
+            int64_t rows = prediction.shape(0);
+            int64_t cols = prediction.shape(1);
+            std::vector<std::vector<double>> probabilities(rows, std::vector<double>(cols));
+            // XGBoost returns float32, the rest float64
+            if (prediction.get_dtype() == np::dtype::get_builtin<float>()) {
+                float* data = reinterpret_cast<float*>(prediction.get_data());
+                for (int64_t row = 0; row < rows; ++row) {
+                    std::copy(data + row * cols, data + (row + 1) * cols, probabilities[row].begin());
+                }
+            } else if (prediction.get_dtype() == np::dtype::get_builtin<double>()) {
+                double* data = reinterpret_cast<double*>(prediction.get_data());
+                for (int64_t row = 0; row < rows; ++row) {
+                    std::copy(data + row * cols, data + (row + 1) * cols, probabilities[row].begin());
+                }
+            } else {
+                throw std::runtime_error("predict_proba: unexpected data type");
+            }
+            return probabilities;
+        }
+        catch (const std::exception& e) {
+            // Clear any Python errors before re-throwing
+            if (PyErr_Occurred()) {
+                PyErr_Clear();
+            }
+            throw;
+        }
+    }
+    float PyClassifier::score(std::vector<std::vector<int>>& X, std::vector<int>& y)
+    {
+        if (X.empty() || X[0].size() != y.size()) {
+            throw std::runtime_error("score: X and y dimension mismatch");
+        }
+        auto prediction = predict(X);
+        size_t correct = 0;
+        for (size_t i = 0; i < y.size(); ++i) {
+            correct += prediction[i] == y[i];
+        }
+        return static_cast<float>(static_cast<double>(correct) / y.size());
+    }
+    CPyObject PyClassifier::inputArray(torch::Tensor& X, std::vector<torch::Tensor>& buffers)
+    {
+        if (!preprocessing.empty()) {
+            // The pipeline runs inside the one conversion pass, its output is never a view of X
+            auto cached = conversions.find(X, inputDtype);
+            if (cached) {
+                return cached;
+            }
+            auto outputs = preprocessing.outputFeatures();
+            auto Xn = localArray(X.size(1), outputs);
+            void* data = Xn.get_data();
+            {
+                PyGILRelease nogil;
+                convertInto(X, data);
+            }
+            CPyObject array = bp::incref(bp::object(Xn).ptr());
+            conversions.insert(X, inputDtype, array, X.size(1) * outputs * c10::elementSize(inputDtype));
+            return array;
+        }
+        if (isSparseInput(X)) {
+            if (!sparseInput) {
+                throw PyWrapException(module + ":" + className + " doesn't accept sparse input");
+            }
+            return sparse2scipy(X, buffers);
+        }
+        if (X.dim() != 2) {
+            throw std::runtime_error("inputArray: Expected 2D tensor, got " + std::to_string(X.dim()) + "D");
+        }
+        // Views when the estimator can use X as it is, otherwise one parallel transpose/cast
+        // instead of the single threaded copies numpy and sklearn would make
+        bool dtypeMatches = X.scalar_type() == inputDtype || (inputDtype == torch::kFloat32 && isIntegerInput(X));
+        bool viewable = isSampleMajor(X) || (X.is_contiguous() && !sampleMajor);
+        if (dtypeMatches && viewable) {
+            return bp::incref(bp::object(tensorView(X, numpyDtype(X.scalar_type()))).ptr());
+        }
+        // fit -> score -> predict on the same unchanged X pays for one conversion
+        auto cached = conversions.find(X, inputDtype);
+        if (cached) {
+            return cached;
+        }
+        auto Xn = localArray(X.size(1), X.size(0));
+        void* data = Xn.get_data();
+        {
+            PyGILRelease nogil;
+            transposeInto(X, inputDtype, data);
+        }
+        CPyObject array = bp::incref(bp::object(Xn).ptr());
+        conversions.insert(X, inputDtype, array, X.numel() * c10::elementSize(inputDtype));
+        return array;
+    }
+    CPyObject PyClassifier::inputArray(torch::Tensor& X, const Preprocessing& pipeline)
+    {
+        auto Xn = localArray(X.size(1), pipeline.outputFeatures());
+        void* data = Xn.get_data();
+        {
+            PyGILRelease nogil;
+            pipeline.transformInto(X, inputDtype, data);
+        }
+        return bp::incref(bp::object(Xn).ptr());
+    }
+    void PyClassifier::convertInto(const torch::Tensor& X, void* destination) const
+    {
+        if (preprocessing.empty()) {
+            transposeInto(X, inputDtype, destination);
+        } else {
+            preprocessing.transformInto(X, inputDtype, destination);
+        }
+    }
+    void PyClassifier::setPreprocessing(const Preprocessing& pipeline)
+    {
+        PyGILGuard gil;
+        // Cached arrays and the row input were converted for the previous pipeline
+        conversions.clear();
+        resetRowPath();
+        preprocessing = pipeline;
+    }
+    void PyClassifier::setConversionCache(size_t entries)
+    {
+        PyGILGuard gil;
+        conversions.setCapacity(entries);
+    }
+    nlohmann::json PyClassifier::conversionCacheReport() const
+    {
+        return conversions.report();
+    }
+    void PyClassifier::resetRowPath()
+    {
+        // GIL held
+        rowInput.Release();
+        rowData = nullptr;
+    }
+    bool bufferInteger(const Py_buffer& view, int64_t& value)
+    {
+        // First item of an integer buffer of any width, the struct format code tells its signedness
+        char code = view.format[std::strlen(view.format) - 1];
+        if (std::strchr("bBhHiIlLqQ", code) == nullptr) {
+            return false;
+        }
+        bool isSigned = std::islower(static_cast<unsigned char>(code));
+        switch (view.itemsize) {
+            case 1:
+                value = isSigned ? *static_cast<const int8_t*>(view.buf) : *static_cast<const uint8_t*>(view.buf);
+                return true;
+            case 2:
+                value = isSigned ? *static_cast<const int16_t*>(view.buf) : *static_cast<const uint16_t*>(view.buf);
+                return true;
+            case 4:
+                value = isSigned ? *static_cast<const int32_t*>(view.buf) : *static_cast<const uint32_t*>(view.buf);
+                return true;
+            case 8:
+                value = isSigned ? *static_cast<const int64_t*>(view.buf) : static_cast<int64_t>(*static_cast<const uint64_t*>(view.buf));
+                return true;
+            default:
+                return false;
+        }
+    }
+    template <typename T>
+    int PyClassifier::predictRowOf(const T* row)
+    {
+        if (nFeatures == 0) {
+            throw std::runtime_error("predictRow: " + className + " is not fitted");
+        }
+        std::unique_lock<std::mutex> busy(rowMutex, std::try_to_lock);
+        if (!busy.owns_lock()) {
+            // Another thread owns the preallocated row, this call takes the allocating path
+            torch::Tensor X = torch::from_blob(const_cast<T*>(row), { nFeatures, 1 }, std::is_same<T, float>::value ? torch::kFloat32 : torch::kFloat64);
+            return predict(X).item<int>();
+        }
+        ReplicaLease lease(*this);
+        PlacementScope pin(placement);
+        PyGILGuard gil;
+        if (!rowInput) {
+            auto Xn = localArray(1, modelFeatures());
+            rowInput = bp::incref(bp::object(Xn).ptr());
+            rowData = Xn.get_data();
+        }
+        if (!preprocessing.empty()) {
+            auto X = torch::from_blob(const_cast<T*>(row), { nFeatures, 1 }, std::is_same<T, float>::value ? torch::kFloat32 : torch::kFloat64);
+            preprocessing.transformInto(X, inputDtype, rowData);
+        } else if (inputDtype == torch::kFloat64) {
+            std::copy(row, row + nFeatures, static_cast<double*>(rowData));
+        } else {
+            std::copy(row, row + nFeatures, static_cast<float*>(rowData));
+        }
+        PyObjectGuard result(pyWrap->predictRow(lease.id(), rowInput.getObject()));
+        // Read the label through the buffer protocol, no numpy wrapper objects
+        Py_buffer view;
+        if (PyObject_GetBuffer(result, &view, PyBUF_FORMAT | PyBUF_ND) == -1) {
+            PyErr_Clear();
+            throw std::runtime_error("predictRow: unexpected result from " + module + ":" + className);
+        }
+        int64_t label;
+        bool integer = view.format != nullptr && bufferInteger(view, label);
+        PyBuffer_Release(&view);
+        if (!integer) {
+            throw std::runtime_error("predictRow: unexpected data type from " + module + ":" + className);
+        }
+        return static_cast<int>(label);
+    }
+    int PyClassifier::predictRow(const float* row)
+    {
+        return predictRowOf(row);
+    }
+    int PyClassifier::predictRow(const double* row)
     {
-        this->hyperparameters = hyperparameters;
+        return predictRowOf(row);
     }
 } /* namespace pywrap */
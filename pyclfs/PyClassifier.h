@@ -4,6 +4,11 @@
 #include <map>
 #include <vector>
 #include <utility>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <memory>
+#include <functional>
 #include "boost/python/detail/wrap_python.hpp"
 #include <boost/python/numpy.hpp>
 #include <torch/torch.h>
@@ -11,24 +16,61 @@
 #include "bayesnet/classifiers/Classifier.h"
 #include "PyWrap.h"
 #include "TypeId.h"
+#include "Placement.h"
+#include "ConversionCache.h"
+#include "Metrics.h"
+#include "Streaming.h"
+#include "Preprocessing.h"
 
 namespace pywrap {
+    // Tensor [features, samples] to numpy [samples, features] views (no copy when X is contiguous,
+    // otherwise the array owns a transposed copy)
+    boost::python::numpy::ndarray tensor2numpy(torch::Tensor& X);
+    boost::python::numpy::ndarray tensorInt2numpy(torch::Tensor& X);
+    std::pair<boost::python::numpy::ndarray, boost::python::numpy::ndarray> tensors2numpy(torch::Tensor& X, torch::Tensor& y);
+    boost::python::numpy::ndarray labels2numpy(torch::Tensor& y, int64_t samples);
+    // Sparse COO/CSR/CSC [features, samples] tensors go to Python as scipy.sparse matrices
+    bool isSparseInput(const torch::Tensor& X);
+    // uint8, int8, int16 and int32 tensors go to Python as they are, the estimators widen them themselves
+    bool isIntegerInput(const torch::Tensor& X);
+    // Narrowest integer type holding every feature's states (uint8 up to 256 states, int16 up to 32768)
+    torch::ScalarType narrowestDtype(const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states);
     class PyClassifier : public bayesnet::BaseClassifier {
     public:
         PyClassifier(const std::string& module, const std::string& className, const bool sklearn = false);
         virtual ~PyClassifier();
-        PyClassifier& fit(std::vector<std::vector<int>>& X, std::vector<int>& y, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override { return *this; };
-        // X is nxm tensor, y is nx1 tensor
+        // X is [features][samples], converted to numpy in a single pass without an intermediate tensor
+        PyClassifier& fit(std::vector<std::vector<int>>& X, std::vector<int>& y, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override;
+        // X is nxm tensor, y is nx1 tensor. Integer X is narrowed to the width the states allow
         PyClassifier& fit(torch::Tensor& X, torch::Tensor& y, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override;
         PyClassifier& fit(torch::Tensor& X, torch::Tensor& y);
-        PyClassifier& fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override { return *this; };
-        PyClassifier& fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const torch::Tensor& weights, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override { return *this; };
+        // dataset is [features + 1, samples], the last row is y
+        PyClassifier& fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override;
+        // weights [samples] reach the estimator as fit(X, y, sample_weight=weights), zero copy when float64
+        PyClassifier& fit(torch::Tensor& dataset, const std::vector<std::string>& features, const std::string& className, std::map<std::string, std::vector<int>>& states, const torch::Tensor& weights, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override;
+        // Grows the fitted model by n estimators (boosting rounds) trained on X, y and keeps the ones it has.
+        // Only the increment is trained. Throws PyUnsupportedException for estimators that can't continue
+        // their training. A stopped extend leaves the model unfitted, as a stopped fit does
+        PyClassifier& extend(torch::Tensor& X, torch::Tensor& y, int n);
         torch::Tensor predict(torch::Tensor& X) override;
-        std::vector<int> predict(std::vector<std::vector<int >>& X) override { return std::vector<int>(); }; // Not implemented
+        std::vector<int> predict(std::vector<std::vector<int >>& X) override;
         torch::Tensor predict_proba(torch::Tensor& X) override;
-        std::vector<std::vector<double>> predict_proba(std::vector<std::vector<int >>& X) override { return std::vector<std::vector<double>>(); }; // Not implemented
-        float score(std::vector<std::vector<int>>& X, std::vector<int>& y) override { return 0.0; }; // Not implemented
+        std::vector<std::vector<double>> predict_proba(std::vector<std::vector<int >>& X) override;
+        float score(std::vector<std::vector<int>>& X, std::vector<int>& y) override;
+        // One predict and the accuracy counted in C++
         float score(torch::Tensor& X, torch::Tensor& y) override;
+        // Metrics of Metrics.h out of one predict, or one predict_proba when log_loss or roc_auc
+        // are asked for (the labels are then its most probable classes)
+        nlohmann::json evaluate(torch::Tensor& X, torch::Tensor& y, const std::vector<std::string>& metrics = { "accuracy" });
+        // Predicts the rows of source chunk by chunk into sink, labels or probabilities. A reader thread
+        // fills and converts chunk i + 1 while the estimator predicts chunk i: two chunks in memory
+        // whatever the size of the source. Returns the rows predicted
+        int64_t predictStream(ChunkSource& source, PredictionSink& sink, int64_t chunkRows = 65536, bool probabilities = false);
+        // Low latency predict of one row of n_features values: the input array is kept from call to call
+        // and the label is read without numpy wrappers. Goes to the least busy replica under the same
+        // thread budget and CallLimits as predict. Concurrent callers fall back to the regular predict
+        int predictRow(const float* row);
+        int predictRow(const double* row);
         int getClassNumStates() const override { return 0; };
         std::string version();
         std::string callMethodString(const std::string& method);
@@ -44,12 +86,61 @@ namespace pywrap {
         std::vector<std::string> topological_order() override { return std::vector<std::string>(); }
         std::string dump_cpt() const override { return ""; };
         std::vector<std::string> getNotes() const override { return notes; };
+        // Structure of the fitted model, taken right after every fit (see PyWrap::modelMetadata)
+        const nlohmann::json& getMetadata() const { return metadata; }
         void setHyperparameters(const nlohmann::json& hyperparameters) override;
+        // Send the pending hyperparameters to the Python instance (done by the first fit)
+        void applyHyperparameters();
+        clfId_t getId() const { return id; }
+        // Runs the Python calls of this classifier pinned to a cpu set or NUMA node
+        void setPlacement(const Placement& placement);
+        const Placement& getPlacement() const { return placement; }
+        nlohmann::json placementReport() const;
+        // Converted inputs kept for reuse while their tensor is alive and unchanged, 0 disables it
+        void setConversionCache(size_t entries);
+        nlohmann::json conversionCacheReport() const;
+        // Keeps n fitted copies of the model, each with its own registry id. predict, predict_proba
+        // and score go to the least busy of the model and its replicas. Refits replicate again
+        void replicate(int n, CloneMode mode = CloneMode::DeepCopy);
+        int getReplicas() const
+        {
+            std::shared_lock<std::shared_mutex> lock(replicaMutex);
+            return static_cast<int>(replicas.size());
+        }
+        // Pipeline run inside the conversion of X for the estimator. Every fit refits it and stores it in the
+        // metadata as "preprocessing". The "preprocessing" hyperparameter sets it too. Not while predicting
+        void setPreprocessing(const Preprocessing& pipeline);
+        const Preprocessing& getPreprocessing() const { return preprocessing; }
+        // X as fit and predict hand it to the estimator (inputDtype, sparse input, conversion cache and the
+        // fitted pipeline), for callers driving the registered instance through PyWrap. numpy array or
+        // scipy.sparse matrix, buffers keeps alive what it points to (GIL held)
+        CPyObject inputArray(torch::Tensor& X, std::vector<torch::Tensor>& buffers);
+        // Same through pipeline, fitted, instead of the classifier's own. Never cached (GIL held)
+        CPyObject inputArray(torch::Tensor& X, const Preprocessing& pipeline);
+        torch::ScalarType getInputDtype() const { return inputDtype; }
     protected:
         nlohmann::json hyperparameters;
         void trainModel(const torch::Tensor& weights, const bayesnet::Smoothing_t smoothing = bayesnet::Smoothing_t::NONE) override {};
         std::vector<std::string> notes;
         bool xgboost = false;
+        nlohmann::json metadata;
+        // Integer from the metadata snapshot, 0 before the first fit
+        int metadataInt(const std::string& key) const;
+        bool sparseInput = false; // estimator accepts scipy.sparse input
+        // What the estimator computes on: X is converted once by the parallel kernels when it doesn't match
+        torch::ScalarType inputDtype = torch::kFloat32; // integer X is fine as is for float32 estimators
+        bool sampleMajor = false; // estimator copies X to C order (libsvm)
+        // How extend grows a fitted model
+        enum class Growth {
+            None, // it can't
+            WarmStart, // sklearn ensembles: warm_start and a larger n_estimators
+            Continuation // XGBoost: fit(..., xgb_model=booster) with n_estimators more rounds
+        };
+        Growth growth = Growth::None;
+        // Called by the fits that know the features' states, before the hyperparameters are applied
+        virtual void prepareStates(const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states) {}
+        // Sets attributes of the Python instance right away, unlike setHyperparameters
+        void setAttributes(const nlohmann::json& attributes);
     private:
         PyWrap* pyWrap;
         std::string module;
@@ -57,6 +148,62 @@ namespace pywrap {
         bool sklearn;
         clfId_t id;
         bool fitted;
+        // Empty numpy [rows, cols] of inputDtype, on the NUMA node the calling thread is pinned to if any
+        boost::python::numpy::ndarray localArray(int64_t rows, int64_t cols);
+        // Validated numpy array out of a predict/predict_proba result (steals the reference)
+        boost::python::numpy::ndarray resultArray(PyObject* result, const std::string& method, int dimensions);
+        std::vector<int> predictionsVector(boost::python::numpy::ndarray& prediction);
+        torch::Tensor probabilitiesTensor(boost::python::numpy::ndarray& prediction);
+        // X [features, samples] into the row major [samples, modelFeatures()] buffer of inputDtype
+        void convertInto(const torch::Tensor& X, void* destination) const;
+        // Features the estimator sees: nFeatures unless the pipeline selects some
+        int64_t modelFeatures() const { return preprocessing.empty() ? nFeatures : preprocessing.outputFeatures(); }
+        Preprocessing preprocessing;
+        Placement placement;
+        std::atomic<uint64_t> pinnedCalls{ 0 };
+        std::atomic<uint64_t> nodeLocalBytes{ 0 };
+        ConversionCache conversions;
+        struct Replica {
+            clfId_t id;
+            std::atomic<int> inFlight{ 0 };
+        };
+        // Holds the least busy of the model's copies for a call, the replicas aren't rebuilt meanwhile.
+        // Taken without the GIL, the lock order is replicaMutex then GIL
+        class ReplicaLease {
+        public:
+            explicit ReplicaLease(PyClassifier& clf) : guard(clf.replicaMutex), replica(clf.leastBusy()) { replica.inFlight++; }
+            ~ReplicaLease() { replica.inFlight--; }
+            ReplicaLease(const ReplicaLease&) = delete;
+            ReplicaLease& operator=(const ReplicaLease&) = delete;
+            clfId_t id() const { return replica.id; }
+        private:
+            std::shared_lock<std::shared_mutex> guard;
+            Replica& replica;
+        };
+        // replicaMutex held
+        Replica& leastBusy();
+        // Exclusive hold of the replicas. A caller holding the GIL lets it go while it waits, so the
+        // leases can finish their calls
+        std::unique_lock<std::shared_mutex> lockReplicas();
+        void makeReplicas();
+        void dropReplicas();
+        // Converts X and y as fit hands them to the estimator and trains through call, the Python fit taking
+        // them. refit is a fit from scratch: hyperparameters, pipeline and row input are set up again.
+        // Otherwise the fitted model grows (extend). Either way the snapshot and the replicas are taken again
+        PyClassifier& fitInput(torch::Tensor& X, torch::Tensor& y, bool refit, const std::function<void(CPyObject&, CPyObject&)>& call);
+        // A fit stopped by CallLimits, the model is unfitted from then on
+        void fitStopped();
+        Replica primary;
+        std::vector<std::unique_ptr<Replica>> replicas;
+        mutable std::shared_mutex replicaMutex; // shared by the leases, exclusive to rebuild replicas
+        CloneMode replicaMode = CloneMode::DeepCopy;
+        std::atomic<uint64_t> nextReplica{ 0 };
+        template <typename T> int predictRowOf(const T* row);
+        void resetRowPath();
+        int64_t nFeatures = 0;
+        std::mutex rowMutex;
+        CPyObject rowInput; // preallocated [1, n_features] array of inputDtype
+        void* rowData = nullptr;
     };
 } /* namespace pywrap */
 #endif /* PYCLASSIFIER_H */
\ No newline at end of file
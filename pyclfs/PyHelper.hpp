@@ -6,10 +6,20 @@
 #include "boost/python/detail/wrap_python.hpp"
 #include <boost/python/numpy.hpp>
 #include <iostream>
+#include <string>
+#include <vector>
+#include <stdexcept>
 
 namespace pywrap {
     namespace p = boost::python;
     namespace np = boost::python::numpy;
+    // How the embedded interpreter is set up, see PyWrap::Initialize
+    struct InterpreterConfig {
+        bool isolated = false; // ignore PYTHON* environment variables and the user site directory
+        bool site = true; // import site, without it sys.path is only what paths lists
+        std::vector<std::string> paths; // sys.path, empty keeps the computed one
+        std::vector<std::string> preload; // modules imported by a background thread right after startup
+    };
     class CPyInstance {
     public:
         CPyInstance()
@@ -17,6 +27,40 @@ namespace pywrap {
             Py_Initialize();
             np::initialize();
         }
+        explicit CPyInstance(const InterpreterConfig& config)
+        {
+            PyConfig pyConfig;
+            if (config.isolated) {
+                PyConfig_InitIsolatedConfig(&pyConfig);
+            } else {
+                PyConfig_InitPythonConfig(&pyConfig);
+            }
+            pyConfig.site_import = config.site ? 1 : 0;
+            PyStatus status = PyStatus_Ok();
+            if (!config.paths.empty()) {
+                pyConfig.module_search_paths_set = 1;
+                for (const auto& path : config.paths) {
+                    wchar_t* wide = Py_DecodeLocale(path.c_str(), nullptr);
+                    if (wide == nullptr) {
+                        PyConfig_Clear(&pyConfig);
+                        throw std::runtime_error("Couldn't decode sys.path entry " + path);
+                    }
+                    status = PyWideStringList_Append(&pyConfig.module_search_paths, wide);
+                    PyMem_RawFree(wide);
+                    if (PyStatus_Exception(status)) {
+                        break;
+                    }
+                }
+            }
+            if (!PyStatus_Exception(status)) {
+                status = Py_InitializeFromConfig(&pyConfig);
+            }
+            PyConfig_Clear(&pyConfig);
+            if (PyStatus_Exception(status)) {
+                throw std::runtime_error(std::string("Couldn't initialize Python: ") + (status.err_msg ? status.err_msg : "unknown error"));
+            }
+            np::initialize();
+        }
 
         ~CPyInstance()
         {
@@ -219,6 +263,32 @@ namespace pywrap {
         }
     };
 
+    // RAII guard for the GIL - safe to nest, any thread may use it
+    class PyGILGuard {
+    private:
+        PyGILState_STATE state_;
+    public:
+        PyGILGuard() : state_(PyGILState_Ensure()) {}
+        ~PyGILGuard() {
+            PyGILState_Release(state_);
+        }
+        PyGILGuard(const PyGILGuard&) = delete;
+        PyGILGuard& operator=(const PyGILGuard&) = delete;
+    };
+
+    // RAII release of the GIL held by this thread, for pure C++ work in between Python calls
+    class PyGILRelease {
+    private:
+        PyThreadState* state_;
+    public:
+        PyGILRelease() : state_(PyEval_SaveThread()) {}
+        ~PyGILRelease() {
+            PyEval_RestoreThread(state_);
+        }
+        PyGILRelease(const PyGILRelease&) = delete;
+        PyGILRelease& operator=(const PyGILRelease&) = delete;
+    };
+
     // Helper function to create a PyObjectGuard from a borrowed reference
     inline PyObjectGuard borrowReference(PyObject* obj) {
         return PyObjectGuard(obj, true);
@@ -5,6 +5,7 @@
 #include <map>
 #include <sstream>
 #include <boost/python/numpy.hpp>
+#include <ATen/Parallel.h>
 #include <iostream>
 
 namespace pywrap {
@@ -12,21 +13,100 @@ namespace pywrap {
     PyWrap* PyWrap::wrapper = nullptr;
     std::mutex PyWrap::mutex;
     CPyInstance* PyWrap::pyInstance = nullptr;
+    PyThreadState* PyWrap::mainThreadState = nullptr;
+    std::thread PyWrap::preloader;
     // moduleClassMap is now an instance member - removed global declaration
 
     PyWrap* PyWrap::GetInstance()
     {
         std::lock_guard<std::mutex> lock(mutex);
         if (wrapper == nullptr) {
-            wrapper = new PyWrap();
-            pyInstance = new CPyInstance();
-            PyRun_SimpleString("import warnings;warnings.filterwarnings('ignore')");
+            initialize(InterpreterConfig());
         }
         return wrapper;
     }
+    PyWrap* PyWrap::Initialize(const InterpreterConfig& config)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (wrapper != nullptr) {
+            throw PyWrapException("Python interpreter already initialized");
+        }
+        initialize(config);
+        return wrapper;
+    }
+    void PyWrap::initialize(const InterpreterConfig& config)
+    {
+        auto start = std::chrono::steady_clock::now();
+        wrapper = new PyWrap();
+        try {
+            for (const auto& module : config.preload) {
+                wrapper->validateModuleName(module);
+            }
+            pyInstance = new CPyInstance(config);
+        }
+        catch (...) {
+            delete wrapper;
+            wrapper = nullptr;
+            throw;
+        }
+        PyRun_SimpleString("import warnings;warnings.filterwarnings('ignore')");
+        // Release the GIL held by the initializing thread, so any thread
+        // (including this one) can get it back through PyGILState_Ensure
+        mainThreadState = PyEval_SaveThread();
+        wrapper->startup = {
+            { "interpreter_ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() },
+            { "isolated", config.isolated }, { "site", config.site }, { "preload", json::object() }
+        };
+        if (!config.preload.empty()) {
+            // Imports take seconds, they are done here instead of on the first request
+            wrapper->preloading = true;
+            preloader = std::thread(&PyWrap::preload, wrapper, config.preload);
+        }
+    }
+    void PyWrap::preload(const std::vector<std::string>& modules)
+    {
+        auto start = std::chrono::steady_clock::now();
+        json report = json::object();
+        {
+            PyGILGuard gil;
+            for (const auto& name : modules) {
+                auto begin = std::chrono::steady_clock::now();
+                PyObjectGuard module(PyImport_ImportModule(name.c_str()));
+                if (!module) {
+                    PyErr_Clear();
+                    report[name] = "failed";
+                    continue;
+                }
+                report[name] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            }
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        startup["preload"] = report;
+        startup["preload_ms"] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        preloading = false;
+        preloaded.notify_all();
+    }
+    void PyWrap::waitForPreload()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        preloaded.wait(lock, [this] { return !preloading; });
+    }
+    json PyWrap::startupReport()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return startup;
+    }
     void PyWrap::RemoveInstance()
     {
         if (wrapper != nullptr) {
+            if (preloader.joinable()) {
+                // It needs the GIL to finish, join before taking it back
+                preloader.join();
+            }
+            if (mainThreadState != nullptr) {
+                PyEval_RestoreThread(mainThreadState);
+                mainThreadState = nullptr;
+            }
             if (pyInstance != nullptr) {
                 delete pyInstance;
             }
@@ -43,26 +123,25 @@ namespace pywrap {
         validateModuleName(moduleName);
         validateClassName(className);
         
-        std::lock_guard<std::mutex> lock(mutex);
-        auto result = moduleClassMap.find(id);
-        if (result != moduleClassMap.end()) {
-            return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (moduleClassMap.find(id) != moduleClassMap.end()) {
+                return;
+            }
         }
         
-        // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        // Acquire GIL for Python operations. The registry lock is not held meanwhile,
+        // the import may release the GIL and other threads need getClass to proceed
+        PyGILGuard gil;
         try {
             PyObject* module = PyImport_ImportModule(moduleName.c_str());
             if (PyErr_Occurred()) {
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't import module " + moduleName);
             }
             
             PyObject* classObject = PyObject_GetAttrString(module, className.c_str());
             if (PyErr_Occurred()) {
                 Py_DECREF(module);
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't find class " + className);
             }
             
@@ -70,30 +149,40 @@ namespace pywrap {
             if (PyErr_Occurred()) {
                 Py_DECREF(module);
                 Py_DECREF(classObject);
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't create instance of class " + className);
             }
             
-            moduleClassMap.insert({ id, { module, classObject, instance } });
-            PyGILState_Release(gstate);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                moduleClassMap.insert({ id, { module, classObject, instance } });
+            }
         }
-        catch (...) {
-            PyGILState_Release(gstate);
+        catch (const PyWrapException&) {
             throw;
         }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+        }
     }
     void PyWrap::clean(const clfId_t id)
     {
         // Remove Python interpreter if no more modules imported left
-        std::lock_guard<std::mutex> lock(mutex);
-        auto result = moduleClassMap.find(id);
-        if (result == moduleClassMap.end()) {
-            return;
+        // GIL first, then the registry lock, same order as every other method
+        PyGILGuard gil;
+        std::tuple<PyObject*, PyObject*, PyObject*> objects;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto result = moduleClassMap.find(id);
+            if (result == moduleClassMap.end()) {
+                return;
+            }
+            objects = result->second;
+            moduleClassMap.erase(result);
+            userThreads.erase(id);
         }
-        Py_DECREF(std::get<0>(result->second));
-        Py_DECREF(std::get<1>(result->second));
-        Py_DECREF(std::get<2>(result->second));
-        moduleClassMap.erase(result);
+        Py_DECREF(std::get<0>(objects));
+        Py_DECREF(std::get<1>(objects));
+        Py_DECREF(std::get<2>(objects));
         if (PyErr_Occurred()) {
             PyErr_Print();
             errorAbort("Error cleaning module ");
@@ -104,6 +193,60 @@ namespace pywrap {
         //     RemoveInstance();
         // }
     }
+    void PyWrap::cloneClass(const clfId_t id, const clfId_t newId, CloneMode mode)
+    {
+        PyGILGuard gil;
+        PyObject* instance = getClass(id);
+        std::tuple<PyObject*, PyObject*, PyObject*> source;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            source = moduleClassMap.at(id);
+            if (moduleClassMap.find(newId) != moduleClassMap.end()) {
+                throw PyWrapException("Id already registered: " + std::to_string(newId));
+            }
+        }
+        PyObject* clone = nullptr;
+        if (mode == CloneMode::DeepCopy) {
+            PyObjectGuard copyModule(PyImport_ImportModule("copy"));
+            if (!copyModule) {
+                errorAbort("Couldn't import module copy");
+            }
+            clone = PyObject_CallMethod(copyModule, "deepcopy", "O", instance);
+        } else {
+            PyObjectGuard pickle(PyImport_ImportModule("pickle"));
+            if (!pickle) {
+                errorAbort("Couldn't import module pickle");
+            }
+            PyObjectGuard dumps(PyObject_GetAttrString(pickle, "dumps"));
+            PyObjectGuard loads(PyObject_GetAttrString(pickle, "loads"));
+            PyObjectGuard buffers(PyList_New(0));
+            PyObjectGuard args(PyTuple_Pack(1, instance));
+            PyObjectGuard dumpArgs(mode == CloneMode::SharedBuffers
+                ? Py_BuildValue("{s:i,s:N}", "protocol", 5, "buffer_callback", PyObject_GetAttrString(buffers, "append"))
+                : Py_BuildValue("{s:i}", "protocol", 5));
+            PyObjectGuard data(dumps && loads && dumpArgs ? PyObject_Call(dumps, args, dumpArgs) : nullptr);
+            if (!data) {
+                errorAbort("Couldn't pickle instance of class");
+            }
+            // With out of band buffers the arrays of the copy are views of the original's
+            PyObjectGuard loadArgs(PyTuple_Pack(1, data.get()));
+            PyObjectGuard loadKwargs(Py_BuildValue("{s:O}", "buffers", buffers.get()));
+            clone = PyObject_Call(loads, loadArgs, loadKwargs);
+        }
+        if (clone == nullptr) {
+            errorAbort("Couldn't copy instance of class");
+        }
+        Py_INCREF(std::get<0>(source));
+        Py_INCREF(std::get<1>(source));
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            moduleClassMap.insert({ newId, { std::get<0>(source), std::get<1>(source), clone } });
+            if (userThreads.count(id) > 0) {
+                userThreads.insert(newId);
+            }
+        }
+        modelLoaded();
+    }
     void PyWrap::errorAbort(const std::string& message)
     {
         // Clear Python error state
@@ -173,7 +316,8 @@ namespace pywrap {
             "criterion", "splitter", "min_samples_split", "min_samples_leaf",
             "min_weight_fraction_leaf", "max_features", "max_leaf_nodes",
             "min_impurity_decrease", "bootstrap", "oob_score", "n_jobs",
-            "verbose", "warm_start", "class_weight"
+            "verbose", "warm_start", "class_weight", "tree_method", "early_stopping_rounds",
+            "enable_categorical", "feature_types", "max_cat_to_onehot", "max_cat_threshold"
         };
         
         for (const auto& [key, value] : hyperparameters.items()) {
@@ -234,93 +378,131 @@ namespace pywrap {
     std::string PyWrap::callMethodString(const clfId_t id, const std::string& method)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             PyObject* instance = getClass(id);
             PyObject* result;
             
             if (!(result = PyObject_CallMethod(instance, method.c_str(), NULL))) {
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't call method " + method);
             }
             
             std::string value = PyUnicode_AsUTF8(result);
             Py_XDECREF(result);
-            PyGILState_Release(gstate);
             return value;
         }
         catch (const std::exception& e) {
-            PyGILState_Release(gstate);
             errorAbort(e.what());
             return ""; // This line should never be reached due to errorAbort throwing
         }
-        catch (...) {
-            PyGILState_Release(gstate);
-            throw;
-        }
     }
     int PyWrap::callMethodInt(const clfId_t id, const std::string& method)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             PyObject* instance = getClass(id);
             PyObject* result;
             
             if (!(result = PyObject_CallMethod(instance, method.c_str(), NULL))) {
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't call method " + method);
             }
             
             int value = PyLong_AsLong(result);
             Py_XDECREF(result);
-            PyGILState_Release(gstate);
             return value;
         }
         catch (const std::exception& e) {
-            PyGILState_Release(gstate);
             errorAbort(e.what());
             return 0; // This line should never be reached due to errorAbort throwing
         }
-        catch (...) {
-            PyGILState_Release(gstate);
-            throw;
+    }
+    json PyWrap::modelMetadata(const clfId_t id)
+    {
+        static const char* code = R"(
+import json
+def _tree_stats(estimator):
+    if hasattr(estimator, "get_nodes"):
+        return {"nodes": int(estimator.get_nodes()), "leaves": int(estimator.get_leaves()), "depth": int(estimator.get_depth())}
+    if hasattr(estimator, "tree_"):
+        return {"nodes": int(estimator.tree_.node_count), "leaves": int(estimator.get_n_leaves()), "depth": int(estimator.get_depth())}
+    return None
+def _pywrap_metadata(model):
+    result = {}
+    if hasattr(model, "n_features_in_"):
+        result["n_features"] = int(model.n_features_in_)
+    if hasattr(model, "classes_"):
+        result["classes"] = [c.item() if hasattr(c, "item") else c for c in model.classes_]
+    stats = _tree_stats(model)
+    estimators = getattr(model, "estimators_", None)
+    if isinstance(estimators, (list, tuple)):
+        per_estimator = [s for s in (_tree_stats(e) for e in estimators) if s is not None]
+        result["n_estimators"] = len(estimators)
+        if per_estimator:
+            result["estimators"] = per_estimator
+            if stats is None:
+                stats = {key: sum(s[key] for s in per_estimator) for key in ("nodes", "leaves", "depth")}
+    if hasattr(model, "get_booster"):
+        result["n_estimators"] = int(model.get_booster().num_boosted_rounds())
+    if stats is not None:
+        result.update(stats)
+    return json.dumps(result)
+)";
+        PyGILGuard gil;
+        try {
+            if (metadataFunction == nullptr) {
+                PyObjectGuard globals(PyDict_New());
+                PyDict_SetItemString(globals, "__builtins__", PyEval_GetBuiltins());
+                PyObjectGuard run(PyRun_String(code, Py_file_input, globals, globals));
+                if (!run) {
+                    errorAbort("Couldn't define the model metadata function");
+                }
+                metadataFunction = PyDict_GetItemString(globals, "_pywrap_metadata");
+                Py_XINCREF(metadataFunction);
+            }
+            PyObject* instance = getClass(id);
+            PyObjectGuard result(PyObject_CallOneArg(metadataFunction, instance));
+            if (!result) {
+                errorAbort("Couldn't gather the model metadata");
+            }
+            return json::parse(PyUnicode_AsUTF8(result));
+        }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+            return json(); // This line should never be reached due to errorAbort throwing
         }
     }
     std::string PyWrap::sklearnVersion()
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             // Validate module name for security
             validateModuleName("sklearn");
             
             PyObject* sklearnModule = PyImport_ImportModule("sklearn");
             if (sklearnModule == nullptr) {
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't import sklearn");
             }
             
             PyObject* versionAttr = PyObject_GetAttrString(sklearnModule, "__version__");
             if (versionAttr == nullptr || !PyUnicode_Check(versionAttr)) {
                 Py_XDECREF(sklearnModule);
-                PyGILState_Release(gstate);
                 errorAbort("Couldn't get sklearn version");
             }
             
             std::string result = PyUnicode_AsUTF8(versionAttr);
             Py_XDECREF(versionAttr);
             Py_XDECREF(sklearnModule);
-            PyGILState_Release(gstate);
             return result;
         }
-        catch (...) {
-            PyGILState_Release(gstate);
+        catch (const PyWrapException&) {
             throw;
         }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+            return "";
+        }
     }
     std::string PyWrap::version(const clfId_t id)
     {
@@ -329,14 +511,12 @@ namespace pywrap {
     int PyWrap::callMethodSumOfItems(const clfId_t id, const std::string& method)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             // Call method on each estimator and sum the results (made for RandomForest)
             PyObject* instance = getClass(id);
             PyObject* estimators = PyObject_GetAttrString(instance, "estimators_");
             if (estimators == nullptr) {
-                PyGILState_Release(gstate);
                 errorAbort("Failed to get attribute: " + method);
             }
             
@@ -349,14 +529,12 @@ namespace pywrap {
                     PyObject* owner = PyObject_GetAttrString(estimator, "tree_");
                     if (owner == nullptr) {
                         Py_XDECREF(estimators);
-                        PyGILState_Release(gstate);
                         errorAbort("Failed to get attribute tree_ for: " + method);
                     }
                     result = PyObject_GetAttrString(owner, method.c_str());
                     if (result == nullptr) {
                         Py_XDECREF(estimators);
                         Py_XDECREF(owner);
-                        PyGILState_Release(gstate);
                         errorAbort("Failed to get attribute node_count: " + method);
                     }
                     Py_DECREF(owner);
@@ -364,7 +542,6 @@ namespace pywrap {
                     result = PyObject_CallMethod(estimator, method.c_str(), nullptr);
                     if (result == nullptr) {
                         Py_XDECREF(estimators);
-                        PyGILState_Release(gstate);
                         errorAbort("Failed to call method: " + method);
                     }
                 }
@@ -372,22 +549,27 @@ namespace pywrap {
                 Py_DECREF(result);
             }
             Py_DECREF(estimators);
-            PyGILState_Release(gstate);
             return sumOfItems;
         }
-        catch (...) {
-            PyGILState_Release(gstate);
+        catch (const PyWrapException&) {
             throw;
         }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+            return 0;
+        }
     }
     void PyWrap::setHyperparameters(const clfId_t id, const json& hyperparameters)
     {
         // Validate hyperparameters for security
         validateHyperparameters(hyperparameters);
+        if (hyperparameters.contains("n_jobs")) {
+            std::lock_guard<std::mutex> lock(mutex);
+            userThreads.insert(id);
+        }
         
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             // Set hyperparameters as attributes of the class
             PyObject* pValue;
@@ -398,6 +580,21 @@ namespace pywrap {
                 oss << value.type_name();
                 if (oss.str() == "string") {
                     pValue = Py_BuildValue("s", value.get<std::string>().c_str());
+                } else if (value.is_null()) {
+                    Py_INCREF(Py_None);
+                    pValue = Py_None;
+                } else if (value.is_boolean()) {
+                    pValue = PyBool_FromLong(value.get<bool>());
+                } else if (value.is_array()) {
+                    // Lists of strings, e.g. xgboost's feature_types
+                    pValue = PyList_New(value.size());
+                    for (size_t i = 0; pValue && i < value.size(); ++i) {
+                        if (!value[i].is_string()) {
+                            Py_DECREF(pValue);
+                            throw PyWrapException("Only lists of strings are supported for hyperparameter: " + key);
+                        }
+                        PyList_SET_ITEM(pValue, i, PyUnicode_FromString(value[i].get<std::string>().c_str()));
+                    }
                 } else {
                     if (value.is_number_integer()) {
                         pValue = Py_BuildValue("i", value.get<int>());
@@ -407,49 +604,136 @@ namespace pywrap {
                 }
                 
                 if (!pValue) {
-                    PyGILState_Release(gstate);
                     throw PyWrapException("Failed to create Python value for hyperparameter: " + key);
                 }
                 
                 int res = PyObject_SetAttrString(instance, key.c_str(), pValue);
                 if (res == -1 && PyErr_Occurred()) {
                     Py_XDECREF(pValue);
-                    PyGILState_Release(gstate);
                     errorAbort("Couldn't set attribute " + key + "=" + value.dump());
                 }
                 Py_XDECREF(pValue);
             }
-            PyGILState_Release(gstate);
         }
-        catch (...) {
-            PyGILState_Release(gstate);
+        catch (const PyWrapException&) {
             throw;
         }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+        }
     }
     void PyWrap::fit(const clfId_t id, CPyObject& X, CPyObject& y)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             PyObject* instance = getClass(id);
+            ThreadScope threads(*this, id, instance);
             CPyObject result;
             CPyObject method = PyUnicode_FromString("fit");
-            
+            CallWatch watch(*this, "fit");
             if (!(result = PyObject_CallMethodObjArgs(instance, method.getObject(), X.getObject(), y.getObject(), NULL))) {
-                PyGILState_Release(gstate);
+                watch.check();
                 errorAbort("Couldn't call method fit");
             }
-            PyGILState_Release(gstate);
+            modelLoaded();
+        }
+        catch (const PyCancelledException&) {
+            resetInstance(id);
+            throw;
         }
         catch (const std::exception& e) {
-            PyGILState_Release(gstate);
             errorAbort(e.what());
         }
-        catch (...) {
-            PyGILState_Release(gstate);
+    }
+    bool PyWrap::acceptsArgument(PyObject* callable, const std::string& argument)
+    {
+        PyObjectGuard inspect(PyImport_ImportModule("inspect"));
+        if (!inspect) {
+            errorAbort("Couldn't import module inspect");
+        }
+        PyObjectGuard signature(PyObject_CallMethod(inspect, "signature", "O", callable));
+        if (!signature) {
+            // Builtins may have no signature, let the call itself decide
+            PyErr_Clear();
+            return true;
+        }
+        PyObjectGuard parameters(PyObject_GetAttrString(signature, "parameters"));
+        if (!parameters) {
+            errorAbort("Couldn't get the parameters of the signature");
+        }
+        return PyMapping_HasKeyString(parameters, argument.c_str()) == 1;
+    }
+    void PyWrap::fitWeighted(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& weights)
+    {
+        // Acquire GIL for Python operations
+        PyGILGuard gil;
+        try {
+            PyObject* instance = getClass(id);
+            PyObjectGuard method(PyObject_GetAttrString(instance, "fit"));
+            if (!method) {
+                errorAbort("Couldn't find method fit");
+            }
+            if (!acceptsArgument(method, "sample_weight")) {
+                throw PyWrapException("Estimator's fit doesn't accept sample_weight");
+            }
+            ThreadScope threads(*this, id, instance);
+            PyObjectGuard args(PyTuple_Pack(2, X.getObject(), y.getObject()));
+            PyObjectGuard kwargs(Py_BuildValue("{s:O}", "sample_weight", weights.getObject()));
+            CallWatch watch(*this, "fit");
+            PyObjectGuard result(PyObject_Call(method, args, kwargs));
+            if (!result) {
+                watch.check();
+                errorAbort("Couldn't call method fit with sample_weight");
+            }
+            modelLoaded();
+        }
+        catch (const PyCancelledException&) {
+            resetInstance(id);
+            throw;
+        }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+        }
+    }
+    void PyWrap::fitContinued(const clfId_t id, CPyObject& X, CPyObject& y)
+    {
+        // Acquire GIL for Python operations
+        PyGILGuard gil;
+        try {
+            PyObject* instance = getClass(id);
+            PyObjectGuard method(PyObject_GetAttrString(instance, "fit"));
+            if (!method) {
+                errorAbort("Couldn't find method fit");
+            }
+            if (!acceptsArgument(method, "xgb_model")) {
+                throw PyUnsupportedException("Estimator's fit doesn't accept xgb_model");
+            }
+            PyObjectGuard booster(PyObject_CallMethod(instance, "get_booster", NULL));
+            if (!booster) {
+                errorAbort("Couldn't get the booster of the model");
+            }
+            ThreadScope threads(*this, id, instance);
+            PyObjectGuard args(PyTuple_Pack(2, X.getObject(), y.getObject()));
+            PyObjectGuard kwargs(Py_BuildValue("{s:O}", "xgb_model", booster.get()));
+            CallWatch watch(*this, "fit");
+            PyObjectGuard result(PyObject_Call(method, args, kwargs));
+            if (!result) {
+                watch.check();
+                errorAbort("Couldn't call method fit with xgb_model");
+            }
+            modelLoaded();
+        }
+        catch (const PyCancelledException&) {
+            resetInstance(id);
+            throw;
+        }
+        catch (const PyUnsupportedException&) {
             throw;
         }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+        }
     }
     PyObject* PyWrap::predict_proba(const clfId_t id, CPyObject& X)
     {
@@ -459,62 +743,384 @@ namespace pywrap {
     {
         return predict_method("predict", id, X);
     }
+    PyObject* PyWrap::predictRow(const clfId_t id, PyObject* X)
+    {
+        PyGILGuard gil;
+        try {
+            if (predictName == nullptr) {
+                predictName = PyUnicode_InternFromString("predict");
+            }
+            PyObject* instance = getClass(id);
+            ThreadScope threads(*this, id, instance);
+            GcSection section(*this);
+            CallWatch watch(*this, "predict");
+            PyObject* result = PyObject_CallMethodOneArg(instance, predictName, X);
+            if (result == nullptr) {
+                watch.check();
+                errorAbort("Couldn't call method predict");
+            }
+            return result; // Caller must free this object
+        }
+        catch (const PyCancelledException&) {
+            throw;
+        }
+        catch (const std::exception& e) {
+            errorAbort(e.what());
+            return nullptr;
+        }
+    }
     PyObject* PyWrap::predict_method(const std::string name, const clfId_t id, CPyObject& X)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             PyObject* instance = getClass(id);
+            ThreadScope threads(*this, id, instance);
+            GcSection section(*this);
             PyObject* result;
             CPyObject method = PyUnicode_FromString(name.c_str());
-            
+            CallWatch watch(*this, name);
             if (!(result = PyObject_CallMethodObjArgs(instance, method.getObject(), X.getObject(), NULL))) {
-                PyGILState_Release(gstate);
+                watch.check();
                 errorAbort("Couldn't call method " + name);
             }
-            
-            PyGILState_Release(gstate);
             // PyObject_CallMethodObjArgs already returns a new reference, no need for Py_INCREF
             return result; // Caller must free this object
         }
+        catch (const PyCancelledException&) {
+            throw;
+        }
         catch (const std::exception& e) {
-            PyGILState_Release(gstate);
             errorAbort(e.what());
             return nullptr; // This line should never be reached due to errorAbort throwing
         }
-        catch (...) {
-            PyGILState_Release(gstate);
-            throw;
-        }
     }
     double PyWrap::score(const clfId_t id, CPyObject& X, CPyObject& y)
     {
         // Acquire GIL for Python operations
-        PyGILState_STATE gstate = PyGILState_Ensure();
-        
+        PyGILGuard gil;
         try {
             PyObject* instance = getClass(id);
+            ThreadScope threads(*this, id, instance);
+            GcSection section(*this);
             CPyObject result;
             CPyObject method = PyUnicode_FromString("score");
-            
+            CallWatch watch(*this, "score");
             if (!(result = PyObject_CallMethodObjArgs(instance, method.getObject(), X.getObject(), y.getObject(), NULL))) {
-                PyGILState_Release(gstate);
+                watch.check();
                 errorAbort("Couldn't call method score");
             }
-            
-            double resultValue = PyFloat_AsDouble(result);
-            PyGILState_Release(gstate);
-            return resultValue;
+            return PyFloat_AsDouble(result);
+        }
+        catch (const PyCancelledException&) {
+            throw;
         }
         catch (const std::exception& e) {
-            PyGILState_Release(gstate);
             errorAbort(e.what());
             return 0.0; // This line should never be reached due to errorAbort throwing
         }
-        catch (...) {
-            PyGILState_Release(gstate);
-            throw;
+    }
+    void PyWrap::resetInstance(const clfId_t id)
+    {
+        // The stopped fit may have left the estimator half trained, sklearn's clone does the same
+        PyObject* instance = getClass(id);
+        PyObjectGuard type(PyObject_Type(instance));
+        PyObjectGuard parameters(PyObject_HasAttrString(instance, "get_params") ? PyObject_CallMethod(instance, "get_params", "O", Py_False) : PyDict_New());
+        PyObjectGuard noArguments(PyTuple_New(0));
+        PyObject* fresh = parameters ? PyObject_Call(type, noArguments, parameters) : nullptr;
+        if (fresh == nullptr) {
+            errorAbort("Couldn't reset the estimator of a stopped fit");
+        }
+        PyObject* previous;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& entry = moduleClassMap.at(id);
+            previous = std::get<2>(entry);
+            std::get<2>(entry) = fresh;
+        }
+        Py_DECREF(previous);
+    }
+    void PyWrap::throwStopped(StopReason reason, const std::string& method)
+    {
+        if (reason == StopReason::Deadline) {
+            throw PyDeadlineException("Deadline exceeded in method " + method);
+        }
+        throw PyCancelledException("Cancelled method " + method);
+    }
+    PyWrap::CallWatch::CallWatch(PyWrap& wrap, const std::string& method) : method(method)
+    {
+        auto limits = CallLimits::current();
+        if (limits == nullptr) {
+            return;
+        }
+        auto reason = limits->stopReason();
+        if (reason != StopReason::None) {
+            throwStopped(reason, method);
+        }
+        if (wrap.stoppedType == nullptr) {
+            // BaseException, so the estimators' own except Exception clauses let it through
+            wrap.stoppedType = PyErr_NewException("pywrap.CallStopped", PyExc_BaseException, nullptr);
+            if (wrap.stoppedType == nullptr) {
+                wrap.errorAbort("Couldn't create the exception of stopped calls");
+            }
+        }
+        ticket = Watchdog::instance().watch(*limits, wrap.stoppedType);
+    }
+    PyWrap::CallWatch::~CallWatch()
+    {
+        if (ticket != 0) {
+            Watchdog::instance().unwatch(ticket);
+        }
+    }
+    void PyWrap::CallWatch::check()
+    {
+        if (ticket == 0) {
+            return;
+        }
+        auto reason = Watchdog::instance().unwatch(ticket);
+        ticket = 0;
+        if (reason != StopReason::None) {
+            PyErr_Clear();
+            throwStopped(reason, method);
+        }
+    }
+    PyObject* PyWrap::selectRows(CPyObject& X, CPyObject& indices)
+    {
+        // Fancy indexing gathers the rows inside numpy, X itself is never copied whole
+        PyObject* rows = PyObject_GetItem(X.getObject(), indices.getObject());
+        if (rows == nullptr) {
+            errorAbort("Couldn't select rows by index");
+        }
+        return rows;
+    }
+    void PyWrap::fit(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& indices)
+    {
+        PyGILGuard gil;
+        CPyObject Xs = selectRows(X, indices);
+        CPyObject ys = selectRows(y, indices);
+        fit(id, Xs, ys);
+    }
+    double PyWrap::score(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& indices)
+    {
+        PyGILGuard gil;
+        CPyObject Xs = selectRows(X, indices);
+        CPyObject ys = selectRows(y, indices);
+        return score(id, Xs, ys);
+    }
+    void PyWrap::setThreadBudget(int threads)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (threads != 0) {
+            if (!budgetEnabled) {
+                intraOpThreads = at::get_num_threads();
+            }
+            threadBudget.setThreads(threads);
+            // libtorch intra-op pool (used by the tensor conversions) stays inside the budget too
+            at::set_num_threads(threadBudget.getThreads());
+        } else if (budgetEnabled) {
+            at::set_num_threads(intraOpThreads);
+        }
+        budgetEnabled = threads != 0;
+    }
+    int PyWrap::getThreadBudget() const
+    {
+        return budgetEnabled ? threadBudget.getThreads() : 0;
+    }
+    PyObject* PyWrap::threadpoolLimits()
+    {
+        // threadpoolctl is optional, without it only n_jobs is limited
+        if (!threadpoolChecked) {
+            threadpoolChecked = true;
+            PyObjectGuard module(PyImport_ImportModule("threadpoolctl"));
+            if (module) {
+                threadpoolLimitsClass = PyObject_GetAttrString(module, "threadpool_limits");
+            }
+            PyErr_Clear();
+        }
+        return threadpoolLimitsClass;
+    }
+    PyWrap::ThreadScope::ThreadScope(PyWrap& wrap, const clfId_t id, PyObject* instance) : wrap(wrap)
+    {
+        // The handler is per context and thread states come and go with PyGILState, so it is set per call
+        if (wrap.poolEnabled) {
+            previousHandler = NumpyPool::instance().activate();
+        }
+        if (!wrap.budgetEnabled) {
+            return;
+        }
+        // Don't keep the GIL while waiting, the calls holding the budget need it to finish
+        Py_BEGIN_ALLOW_THREADS
+        granted = wrap.threadBudget.acquire();
+        Py_END_ALLOW_THREADS
+        bool userJobs;
+        {
+            std::lock_guard<std::mutex> lock(wrap.mutex);
+            userJobs = wrap.userThreads.count(id) > 0;
+        }
+        if (!userJobs && PyObject_HasAttrString(instance, "n_jobs")) {
+            PyObjectGuard jobs(PyLong_FromLong(granted));
+            if (PyObject_SetAttrString(instance, "n_jobs", jobs) == -1) {
+                PyErr_Clear();
+            }
+        }
+        if (PyObject* limitsClass = wrap.threadpoolLimits()) {
+            PyObjectGuard args(Py_BuildValue("(i)", granted));
+            limits = PyObject_CallObject(limitsClass, args);
+            if (limits == nullptr) {
+                PyErr_Clear();
+            }
+        }
+    }
+    PyWrap::ThreadScope::~ThreadScope()
+    {
+        if (limits != nullptr) {
+            PyObjectGuard restored(PyObject_CallMethod(limits, "restore_original_limits", NULL));
+            if (!restored) {
+                PyErr_Clear();
+            }
+            Py_DECREF(limits);
+        }
+        if (granted > 0) {
+            wrap.threadBudget.release(granted);
+        }
+        NumpyPool::instance().restore(previousHandler);
+    }
+    void PyWrap::setNumpyPool(bool enabled, size_t limitBytes)
+    {
+        auto& pool = NumpyPool::instance();
+        if (enabled) {
+            PyGILGuard gil;
+            if (!pool.available()) {
+                throw PyWrapException("numpy data memory handlers need numpy >= 1.22");
+            }
+        }
+        pool.setLimit(limitBytes);
+        poolEnabled = enabled;
+    }
+    json PyWrap::metrics()
+    {
+        json result;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            result["instances"] = moduleClassMap.size();
+        }
+        result["thread_budget"] = { { "enabled", budgetEnabled.load() }, { "threads", threadBudget.getThreads() }, { "in_use", threadBudget.inUse() } };
+        auto pool = NumpyPool::instance().stats();
+        pool["enabled"] = poolEnabled.load();
+        result["numpy_pool"] = pool;
+        static const std::map<GcPolicy, std::string> policies = {
+            { GcPolicy::Default, "default" }, { GcPolicy::Freeze, "freeze" }, { GcPolicy::Deferred, "deferred" }, { GcPolicy::Disabled, "disabled" }
+        };
+        result["watchdog"] = Watchdog::instance().stats();
+        std::lock_guard<std::mutex> lock(gcMutex);
+        result["gc"] = {
+            { "policy", policies.at(gcPolicy) }, { "collections", gcStats.collections }, { "collected", gcStats.collected },
+            { "pause_total_ms", gcStats.totalPause }, { "pause_max_ms", gcStats.maxPause }
+        };
+        return result;
+    }
+    PyObject* PyWrap::gcMethod(const char* method, const char* format, int argument)
+    {
+        if (gcModule == nullptr) {
+            gcModule = PyImport_ImportModule("gc");
+            if (gcModule == nullptr) {
+                errorAbort("Couldn't import module gc");
+            }
+        }
+        PyObject* result = format == nullptr ? PyObject_CallMethod(gcModule, method, NULL) : PyObject_CallMethod(gcModule, method, format, argument);
+        if (result == nullptr) {
+            errorAbort(std::string("Couldn't call gc.") + method);
+        }
+        return result;
+    }
+    PyObject* PyWrap::gcCallback(PyObject* self, PyObject* args)
+    {
+        // gc.callbacks entry: (phase, info) around every collection, GIL held
+        const char* phase;
+        PyObject* info;
+        if (!PyArg_ParseTuple(args, "sO", &phase, &info)) {
+            return nullptr;
+        }
+        auto wrap = static_cast<PyWrap*>(PyCapsule_GetPointer(self, "pywrap.gc"));
+        if (wrap == nullptr) {
+            return nullptr;
+        }
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(wrap->gcMutex);
+        auto& stats = wrap->gcStats;
+        if (std::string(phase) == "start") {
+            stats.start = now;
+            Py_RETURN_NONE;
+        }
+        auto pause = std::chrono::duration<double, std::milli>(now - stats.start).count();
+        stats.totalPause += pause;
+        stats.maxPause = std::max(stats.maxPause, pause);
+        auto generation = PyLong_AsLong(PyDict_GetItemString(info, "generation"));
+        if (generation >= 0 && generation < 3) {
+            stats.collections[generation]++;
+        }
+        if (PyObject* collected = PyDict_GetItemString(info, "collected")) {
+            stats.collected += PyLong_AsUnsignedLongLong(collected);
+        }
+        PyErr_Clear();
+        Py_RETURN_NONE;
+    }
+    void PyWrap::setGcPolicy(GcPolicy policy)
+    {
+        PyGILGuard gil;
+        static PyMethodDef callbackDef = { "pywrap_gc_callback", PyWrap::gcCallback, METH_VARARGS, nullptr };
+        if (!gcCallbackSet) {
+            PyObjectGuard enabled(gcMethod("isenabled"));
+            PyObjectGuard self(PyCapsule_New(this, "pywrap.gc", nullptr));
+            PyObjectGuard callback(PyCFunction_New(&callbackDef, self));
+            PyObjectGuard callbacks(PyObject_GetAttrString(gcModule, "callbacks"));
+            if (!callback || !callbacks || PyList_Append(callbacks, callback) == -1) {
+                errorAbort("Couldn't register gc callback");
+            }
+            gcCallbackSet = true;
+        }
+        if (policy == GcPolicy::Default && gcPolicy != GcPolicy::Default) {
+            // The models frozen under the previous policy are scanned by the collector again
+            PyObjectGuard unfrozen(gcMethod("unfreeze"));
+        }
+        PyObjectGuard result(gcMethod(policy == GcPolicy::Disabled || hotSections > 0 ? "disable" : "enable"));
+        gcPolicy = policy;
+    }
+    void PyWrap::collectGarbage(int generation)
+    {
+        PyGILGuard gil;
+        PyObjectGuard collected(gcMethod("collect", "i", generation));
+    }
+    void PyWrap::modelLoaded()
+    {
+        if (gcPolicy == GcPolicy::Default) {
+            return;
+        }
+        // Fitted models are long lived, scanning them again in every full collection only costs pauses
+        PyObjectGuard frozen(gcMethod("freeze"));
+    }
+    PyWrap::GcSection::GcSection(PyWrap& wrap) : wrap(wrap)
+    {
+        if (wrap.gcPolicy != GcPolicy::Deferred) {
+            return;
+        }
+        if (wrap.hotSections == 0) {
+            PyObjectGuard disabled(wrap.gcMethod("disable"));
+        }
+        wrap.hotSections++;
+        active = true;
+    }
+    PyWrap::GcSection::~GcSection()
+    {
+        if (!active) {
+            return;
+        }
+        if (--wrap.hotSections == 0 && wrap.gcPolicy != GcPolicy::Disabled) {
+            // Pending collections run from the next allocation, outside of the predict
+            PyObjectGuard enabled(PyObject_CallMethod(wrap.gcModule, "enable", NULL));
+            if (!enabled) {
+                PyErr_Clear();
+            }
         }
     }
-}
\ No newline at end of file
+}
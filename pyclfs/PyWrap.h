@@ -4,13 +4,21 @@
 #include <map>
 #include <tuple>
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
 #include <regex>
 #include <set>
+#include <array>
+#include <chrono>
 #include <nlohmann/json.hpp>
 #include <stdexcept>
 #include "boost/python/detail/wrap_python.hpp"
 #include "PyHelper.hpp"
 #include "TypeId.h"
+#include "ThreadBudget.h"
+#include "NumpyPool.h"
+#include "Cancellation.h"
 #pragma once
 
 
@@ -49,11 +57,46 @@ namespace pywrap {
         explicit PyMethodException(const std::string& method) 
             : PyWrapException("Failed to call Python method: " + method) {}
     };
+    // The estimator can't do what was asked of it, e.g. grow a fitted model
+    class PyUnsupportedException : public PyWrapException {
+    public:
+        explicit PyUnsupportedException(const std::string& message) : PyWrapException(message) {}
+    };
+    // A call stopped by its CallLimits. A stopped fit leaves an unfitted estimator with the same hyperparameters
+    class PyCancelledException : public PyWrapException {
+    public:
+        explicit PyCancelledException(const std::string& message) : PyWrapException(message) {}
+    };
+
+    class PyDeadlineException : public PyCancelledException {
+    public:
+        explicit PyDeadlineException(const std::string& message) : PyCancelledException(message) {}
+    };
+    // How the cyclic garbage collector behaves around the wrapped calls
+    enum class GcPolicy {
+        Default, // collector untouched
+        Freeze, // models are moved to the permanent generation (gc.freeze) after fit/clone
+        Deferred, // Freeze, and no collections while predict/predict_proba/score run
+        Disabled // Freeze, and no automatic collections at all, only collectGarbage
+    };
+    // How a registered instance is copied by cloneClass
+    enum class CloneMode {
+        DeepCopy, // copy.deepcopy
+        Pickle, // pickle round trip, protocol 5
+        SharedBuffers // pickle round trip with out of band buffers, the copy shares the numpy arrays
+    };
     class PyWrap {
     public:
         PyWrap() = default;
         PyWrap(PyWrap& other) = delete;
         static PyWrap* GetInstance();
+        // Starts the interpreter with config instead of the defaults GetInstance would use.
+        // Call it once, before anything else touches PyWrap (throws PyWrapException otherwise)
+        static PyWrap* Initialize(const InterpreterConfig& config);
+        // Blocks until the background preload of InterpreterConfig::preload is done
+        void waitForPreload();
+        // Startup timings: interpreter, and every preloaded module
+        json startupReport();
         void operator=(const PyWrap&) = delete;
         ~PyWrap() = default;
         std::string callMethodString(const clfId_t id, const std::string& method);
@@ -61,15 +104,99 @@ namespace pywrap {
         std::string sklearnVersion();
         std::string version(const clfId_t id);
         int callMethodSumOfItems(const clfId_t id, const std::string& method);
+        // Structure of the fitted model gathered in one Python call: n_features, classes, nodes,
+        // leaves and depth (summed over the estimators of ensembles) and per estimator stats
+        json modelMetadata(const clfId_t id);
         void setHyperparameters(const clfId_t id, const json& hyperparameters);
+        // fit, fitWeighted, fitContinued, predict, predict_proba and score are stopped by the calling thread's CallLimits
         void fit(const clfId_t id, CPyObject& X, CPyObject& y);
+        // Fit/score over the rows of X, y selected by a numpy index array
+        void fit(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& indices);
+        // fit(X, y, sample_weight=weights), throws if the estimator's fit doesn't take sample_weight
+        void fitWeighted(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& weights);
+        // fit(X, y, xgb_model=instance.get_booster()): the booster goes on training n_estimators more rounds
+        void fitContinued(const clfId_t id, CPyObject& X, CPyObject& y);
         PyObject* predict(const clfId_t id, CPyObject& X);
         PyObject* predict_proba(const clfId_t id, CPyObject& X);
+        // predict of the one row array X, its result is returned as it is (predictRow's fast path)
+        PyObject* predictRow(const clfId_t id, PyObject* X);
         double score(const clfId_t id, CPyObject& X, CPyObject& y);
+        double score(const clfId_t id, CPyObject& X, CPyObject& y, CPyObject& indices);
         void clean(const clfId_t id);
+        // Register under newId a copy of the instance registered under id
+        void cloneClass(const clfId_t id, const clfId_t newId, CloneMode mode = CloneMode::DeepCopy);
         void importClass(const clfId_t id, const std::string& moduleName, const std::string& className);
         PyObject* getClass(const clfId_t id);
+        // Process wide thread budget for fit/predict/score calls, 0 disables it, < 0 uses all the cores.
+        // Classifiers without an explicit n_jobs hyperparameter get n_jobs and BLAS threads from the budget
+        void setThreadBudget(int threads);
+        int getThreadBudget() const;
+        // numpy arrays of the fit/predict/score calls get their buffers from a size-class pool
+        // instead of malloc/free. Throws when the numpy in use predates data memory handlers (1.22)
+        void setNumpyPool(bool enabled, size_t limitBytes = 256u << 20);
+        // Garbage collector policy, collection counts and pauses are reported by metrics from then on.
+        // Back to Default unfreezes the objects the other policies moved to the permanent generation
+        void setGcPolicy(GcPolicy policy);
+        GcPolicy getGcPolicy() const { return gcPolicy; }
+        // Runs a collection of generation (0-2) now, for idle points under Deferred/Disabled
+        void collectGarbage(int generation = 2);
+        // Registry, thread budget, numpy pool, garbage collector and watchdog instrumentation
+        json metrics();
     private:
+        // Holds the threads granted to one call and applies them to the instance (GIL held)
+        class ThreadScope {
+        public:
+            ThreadScope(PyWrap& wrap, const clfId_t id, PyObject* instance);
+            ~ThreadScope();
+            ThreadScope(const ThreadScope&) = delete;
+            ThreadScope& operator=(const ThreadScope&) = delete;
+        private:
+            PyWrap& wrap;
+            int granted = 0;
+            PyObject* limits = nullptr;
+            PyObject* previousHandler = nullptr;
+        };
+        // Predict sections under the Deferred policy, the collector is off while any is running (GIL held)
+        class GcSection {
+        public:
+            explicit GcSection(PyWrap& wrap);
+            ~GcSection();
+            GcSection(const GcSection&) = delete;
+            GcSection& operator=(const GcSection&) = delete;
+        private:
+            PyWrap& wrap;
+            bool active = false;
+        };
+        // Stops the call made in its scope when the thread's CallLimits run out (GIL held)
+        class CallWatch {
+        public:
+            // Throws right away if the limits already ran out
+            CallWatch(PyWrap& wrap, const std::string& method);
+            ~CallWatch();
+            CallWatch(const CallWatch&) = delete;
+            CallWatch& operator=(const CallWatch&) = delete;
+            // After a failed call: throws PyCancelledException/PyDeadlineException if the watch stopped it
+            void check();
+        private:
+            std::string method;
+            uint64_t ticket = 0;
+        };
+        struct GcStats {
+            std::array<uint64_t, 3> collections{};
+            uint64_t collected = 0;
+            double totalPause = 0; // milliseconds
+            double maxPause = 0;
+            std::chrono::steady_clock::time_point start;
+        };
+        static PyObject* gcCallback(PyObject* self, PyObject* args);
+        PyObject* gcMethod(const char* method, const char* format = nullptr, int argument = 0);
+        // Freezes the objects alive after a model was fitted or cloned (GIL held)
+        void modelLoaded();
+        PyObject* threadpoolLimits();
+        // Puts a new estimator with the same parameters in place of the one of a stopped fit (GIL held)
+        void resetInstance(const clfId_t id);
+        static void throwStopped(StopReason reason, const std::string& method);
+        PyObject* stoppedType = nullptr; // exception raised in the stopped calls
         // Input validation and security
         void validateModuleName(const std::string& moduleName);
         void validateClassName(const std::string& className);
@@ -77,13 +204,38 @@ namespace pywrap {
         std::string sanitizeErrorMessage(const std::string& message);
         // Only call RemoveInstance from clean method
         static void RemoveInstance();
+        // Both with mutex held
+        static void initialize(const InterpreterConfig& config);
+        void preload(const std::vector<std::string>& modules);
         PyObject* predict_method(const std::string name, const clfId_t id, CPyObject& X);
+        PyObject* selectRows(CPyObject& X, CPyObject& indices);
+        bool acceptsArgument(PyObject* callable, const std::string& argument);
         void errorAbort(const std::string& message);
         // No need to use static map here, since this class is a singleton
         std::map<clfId_t, std::tuple<PyObject*, PyObject*, PyObject*>> moduleClassMap;
+        ThreadBudget threadBudget;
+        std::atomic<bool> budgetEnabled{ false };
+        int intraOpThreads = 0; // at::get_num_threads() before the budget was enabled, restored when disabled
+        std::atomic<bool> poolEnabled{ false };
+        std::set<clfId_t> userThreads; // ids with n_jobs set by the user
+        PyObject* threadpoolLimitsClass = nullptr;
+        PyObject* metadataFunction = nullptr;
+        PyObject* predictName = nullptr; // interned "predict" of predictRow (GIL protected)
+        bool threadpoolChecked = false;
+        std::atomic<GcPolicy> gcPolicy{ GcPolicy::Default };
+        PyObject* gcModule = nullptr;
+        bool gcCallbackSet = false; // gcCallback is in gc.callbacks (GIL protected)
+        int hotSections = 0; // GIL protected
+        GcStats gcStats;
+        mutable std::mutex gcMutex;
         static CPyInstance* pyInstance;
+        static PyThreadState* mainThreadState;
         static PyWrap* wrapper;
         static std::mutex mutex;
+        static std::thread preloader;
+        json startup;
+        bool preloading = false;
+        std::condition_variable preloaded;
     };
 } /* namespace pywrap */
 #endif /* PYWRAP_H */
\ No newline at end of file
@@ -4,17 +4,19 @@ namespace pywrap {
     RandomForest::RandomForest() : PyClassifier("sklearn.ensemble", "RandomForestClassifier", true)
     {
         validHyperparameters = { "n_estimators", "n_jobs", "random_state" };
+        sparseInput = true;
+        growth = Growth::WarmStart;
     }
     int RandomForest::getNumberOfEdges() const
     {
-        return callMethodSumOfItems("get_n_leaves");
+        return metadataInt("leaves");
     }
     int RandomForest::getNumberOfStates() const
     {
-        return callMethodSumOfItems("get_depth");
+        return metadataInt("depth");
     }
     int RandomForest::getNumberOfNodes() const
     {
-        return callMethodSumOfItems("node_count");
+        return metadataInt("nodes");
     }
 } /* namespace pywrap */
\ No newline at end of file
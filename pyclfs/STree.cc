@@ -4,18 +4,20 @@ namespace pywrap {
     STree::STree() : PyClassifier("stree", "Stree")
     {
         validHyperparameters = { "C", "kernel", "max_iter", "max_depth", "random_state", "multiclass_strategy", "gamma", "max_features", "degree" };
+        inputDtype = torch::kFloat64;
+        sampleMajor = true;
     };
     int STree::getNumberOfNodes() const
     {
-        return callMethodInt("get_nodes");
+        return metadataInt("nodes");
     }
     int STree::getNumberOfEdges() const
     {
-        return callMethodInt("get_leaves");
+        return metadataInt("leaves");
     }
     int STree::getNumberOfStates() const
     {
-        return callMethodInt("get_depth");
+        return metadataInt("depth");
     }
     std::string STree::graph()
     {
@@ -4,5 +4,8 @@ namespace pywrap {
     SVC::SVC() : PyClassifier("sklearn.svm", "SVC", true)
     {
         validHyperparameters = { "C", "gamma", "kernel", "random_state" };
+        inputDtype = torch::kFloat64;
+        sampleMajor = true;
+        sparseInput = true;
     }
 } /* namespace pywrap */
\ No newline at end of file
@@ -0,0 +1,310 @@
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <exception>
+#include <optional>
+#include <folding.hpp>
+#include "CrossValidation.h"
+#include "Scheduler.h"
+
+namespace pywrap {
+    namespace bp = boost::python;
+    using json = nlohmann::json;
+    std::string ExperimentCell::key() const
+    {
+        return dataset + "|" + model + "|" + hyperparameters.dump() + "|" + std::to_string(seed) + "|" + std::to_string(fold);
+    }
+    Scheduler::Scheduler(const std::string& resultsFile, int nWorkers) : resultsFile(resultsFile), nWorkers(nWorkers)
+    {
+        if (this->nWorkers <= 0) {
+            this->nWorkers = std::max(1u, std::thread::hardware_concurrency());
+        }
+    }
+    Scheduler::~Scheduler()
+    {
+        // numpy arrays must be released holding the GIL
+        PyGILGuard gil;
+        splits.clear();
+        datasets.clear();
+    }
+    void Scheduler::addDataset(const std::string& name, torch::Tensor& X, torch::Tensor& y)
+    {
+        PyGILGuard gil;
+        auto& dataset = datasets[name];
+        // X is kept as given, the cells' classifiers convert it as their own fit would (see cellInput)
+        dataset.inputs.clear();
+        dataset.X = X;
+        dataset.y = y.contiguous();
+        dataset.yp = bp::incref(bp::object(labels2numpy(dataset.y, X.size(1))).ptr());
+    }
+    CPyObject Scheduler::cellInput(Dataset& dataset, PyClassifier& clf, std::vector<torch::Tensor>& buffers)
+    {
+        if (isSparseInput(dataset.X)) {
+            // scipy views over X's buffers, nothing to share. The classifier also tells whether it takes them
+            return clf.inputArray(dataset.X, buffers);
+        }
+        auto dtype = clf.getInputDtype();
+        {
+            std::lock_guard<std::mutex> lock(inputsMutex);
+            auto item = dataset.inputs.find(dtype);
+            if (item != dataset.inputs.end()) {
+                return item->second;
+            }
+        }
+        // Converted without the lock, the conversion releases the GIL. Two cells racing
+        // for the same dtype both convert and the first one stored is kept
+        CPyObject array = clf.inputArray(dataset.X, buffers);
+        std::lock_guard<std::mutex> lock(inputsMutex);
+        return dataset.inputs.insert({ dtype, array }).first->second;
+    }
+    void Scheduler::addModel(const std::string& name, ClassifierFactory factory, const json& grid)
+    {
+        models[name] = { factory, grid };
+    }
+    void Scheduler::setSeeds(const std::vector<int>& seeds)
+    {
+        this->seeds = seeds;
+    }
+    void Scheduler::setFolds(int folds, bool stratified)
+    {
+        if (folds < 2) {
+            throw std::invalid_argument("Scheduler: folds must be at least 2, got " + std::to_string(folds));
+        }
+        this->folds = folds;
+        this->stratified = stratified;
+    }
+    std::vector<json> Scheduler::expandGrid(const json& grid) const
+    {
+        std::vector<json> combinations = { json::object() };
+        for (const auto& [key, values] : grid.items()) {
+            auto options = values.is_array() ? values : json::array({ values });
+            std::vector<json> expanded;
+            for (const auto& combination : combinations) {
+                for (const auto& value : options) {
+                    auto item = combination;
+                    item[key] = value;
+                    expanded.push_back(item);
+                }
+            }
+            combinations = expanded;
+        }
+        return combinations;
+    }
+    std::vector<ExperimentCell> Scheduler::expand()
+    {
+        std::vector<ExperimentCell> cells;
+        for (const auto& [modelName, model] : models) {
+            auto prototype = model.factory();
+            auto& valid = prototype->getValidHyperparameters();
+            for (const auto& [key, value] : model.grid.items()) {
+                // preprocessing is every PyClassifier's own (see PyClassifier::setPreprocessing)
+                if (key != "preprocessing" && std::find(valid.begin(), valid.end(), key) == valid.end()) {
+                    throw PyWrapException("Invalid hyperparameter " + key + " for model " + modelName);
+                }
+            }
+            bool seeded = std::find(valid.begin(), valid.end(), "random_state") != valid.end();
+            for (auto hyperparameters : expandGrid(model.grid)) {
+                for (const auto& [datasetName, dataset] : datasets) {
+                    for (auto seed : seeds) {
+                        auto cellHyperparameters = hyperparameters;
+                        if (seeded && !cellHyperparameters.contains("random_state")) {
+                            cellHyperparameters["random_state"] = seed;
+                        }
+                        double cost = static_cast<double>(dataset.X.size(0)) * dataset.X.size(1);
+                        if (cellHyperparameters.contains("n_estimators") && cellHyperparameters["n_estimators"].is_number()) {
+                            cost *= cellHyperparameters["n_estimators"].get<double>();
+                        }
+                        for (int fold = 0; fold < folds; ++fold) {
+                            cells.push_back({ datasetName, modelName, cellHyperparameters, seed, fold, cost });
+                        }
+                    }
+                }
+            }
+        }
+        return cells;
+    }
+    std::set<std::string> Scheduler::loadCheckpoint(std::vector<json>& results)
+    {
+        std::set<std::string> done;
+        std::ifstream file(resultsFile);
+        std::string line;
+        while (std::getline(file, line)) {
+            if (line.empty()) {
+                continue;
+            }
+            try {
+                auto result = json::parse(line);
+                done.insert(result.at("key").get<std::string>());
+                results.push_back(result);
+            }
+            catch (const json::exception&) {
+                // An interrupted write leaves a truncated last line, that cell runs again
+            }
+        }
+        return done;
+    }
+    bool Scheduler::nextCell(int worker, ExperimentCell& cell)
+    {
+        {
+            std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+            if (!workers[worker]->cells.empty()) {
+                cell = workers[worker]->cells.front();
+                workers[worker]->cells.pop_front();
+                return true;
+            }
+        }
+        // Steal the smallest cell from the first busy victim, its owner keeps the large ones
+        for (int offset = 1; offset < nWorkers; ++offset) {
+            auto& victim = workers[(worker + offset) % nWorkers];
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (!victim->cells.empty()) {
+                cell = victim->cells.back();
+                victim->cells.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+    json Scheduler::runCell(const ExperimentCell& cell)
+    {
+        auto& dataset = datasets.at(cell.dataset);
+        auto& split = splits.at({ cell.dataset, cell.seed })[cell.fold];
+        auto pyWrap = PyWrap::GetInstance();
+        CallLimits limits(token, cellTimeout);
+        json result = {
+            { "key", cell.key() }, { "dataset", cell.dataset }, { "model", cell.model },
+            { "hyperparameters", cell.hyperparameters }, { "seed", cell.seed }, { "fold", cell.fold }
+        };
+        auto start = std::chrono::steady_clock::now();
+        std::optional<std::chrono::steady_clock::time_point> fitted;
+        // A failing cell is recorded with its status, the other cells go on
+        try {
+            auto clf = models.at(cell.model).factory();
+            clf->setHyperparameters(cell.hyperparameters);
+            clf->applyHyperparameters();
+            std::vector<torch::Tensor> buffers;
+            PyGILGuard gil;
+            CPyObject cellX;
+            if (!clf->getPreprocessing().empty()) {
+                // Fitted on the cell's training rows only, X reaches the estimator through it
+                Preprocessing pipeline = clf->getPreprocessing();
+                {
+                    PyGILRelease nogil;
+                    pipeline.fit(dataset.X.index_select(1, split.trainRows), dataset.y.index_select(0, split.trainRows));
+                }
+                cellX = clf->inputArray(dataset.X, pipeline);
+            }
+            if (!cellX) {
+                cellX = cellInput(dataset, *clf, buffers);
+            }
+            pyWrap->fit(clf->getId(), cellX, dataset.yp, split.train);
+            fitted = std::chrono::steady_clock::now();
+            result["score"] = pyWrap->score(clf->getId(), cellX, dataset.yp, split.test);
+        }
+        catch (const PyDeadlineException&) {
+            result["status"] = "timeout";
+            result["score"] = nullptr;
+        }
+        catch (const PyCancelledException&) {
+            result["status"] = "cancelled";
+            result["score"] = nullptr;
+        }
+        catch (const std::exception& e) {
+            result["status"] = "error";
+            result["error"] = e.what();
+            result["score"] = nullptr;
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (fitted) {
+            result["fit_time"] = std::chrono::duration<double>(*fitted - start).count();
+            result["score_time"] = std::chrono::duration<double>(end - *fitted).count();
+        } else {
+            result["fit_time"] = std::chrono::duration<double>(end - start).count();
+        }
+        return result;
+    }
+    void Scheduler::cancel()
+    {
+        std::lock_guard<std::mutex> lock(resultsMutex);
+        token.cancel();
+    }
+    std::vector<json> Scheduler::run()
+    {
+        {
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            token = CancellationToken();
+        }
+        std::vector<json> results;
+        auto done = loadCheckpoint(results);
+        auto cells = expand();
+        cells.erase(std::remove_if(cells.begin(), cells.end(), [&done](const ExperimentCell& cell) { return done.count(cell.key()) > 0; }), cells.end());
+        std::stable_sort(cells.begin(), cells.end(), [](const ExperimentCell& a, const ExperimentCell& b) { return a.cost > b.cost; });
+        // Fold splits for every (dataset, seed) still needed
+        {
+            PyGILGuard gil;
+            for (const auto& cell : cells) {
+                auto key = std::make_pair(cell.dataset, cell.seed);
+                if (splits.find(key) != splits.end()) {
+                    continue;
+                }
+                auto& y = datasets.at(cell.dataset).y;
+                std::unique_ptr<folding::Fold> fold;
+                if (stratified) {
+                    fold = std::make_unique<folding::StratifiedKFold>(folds, y, cell.seed);
+                } else {
+                    fold = std::make_unique<folding::KFold>(folds, y.size(0), cell.seed);
+                }
+                auto& datasetSplits = splits[key];
+                for (int nFold = 0; nFold < folds; ++nFold) {
+                    auto [train, test] = fold->getFold(nFold);
+                    datasetSplits.push_back({ indices2numpy(train), indices2numpy(test), torch::tensor(train, torch::kInt64) });
+                }
+            }
+        }
+        // Deal the cells round robin, so every deque is sorted largest first too
+        workers.clear();
+        for (int i = 0; i < nWorkers; ++i) {
+            workers.push_back(std::make_unique<Worker>());
+        }
+        for (size_t i = 0; i < cells.size(); ++i) {
+            workers[i % nWorkers]->cells.push_back(cells[i]);
+        }
+        std::ofstream checkpoint(resultsFile, std::ios::app);
+        std::exception_ptr error;
+        std::atomic<bool> failed{ false };
+        auto work = [&](int worker) {
+            ExperimentCell cell;
+            while (!failed && !token.cancelled() && nextCell(worker, cell)) {
+                try {
+                    auto result = runCell(cell);
+                    std::lock_guard<std::mutex> lock(resultsMutex);
+                    // Cells stopped by Scheduler::cancel aren't checkpointed, they run again next time
+                    if (result.value("status", "") != "cancelled") {
+                        checkpoint << result.dump() << std::endl;
+                    }
+                    results.push_back(result);
+                }
+                catch (...) {
+                    std::lock_guard<std::mutex> lock(resultsMutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    failed = true;
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for (int i = 0; i < nWorkers; ++i) {
+            threads.emplace_back(work, i);
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return results;
+    }
+} /* namespace pywrap */
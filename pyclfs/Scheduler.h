@@ -0,0 +1,94 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <torch/torch.h>
+#include <nlohmann/json.hpp>
+#include "PyClassifier.h"
+
+namespace pywrap {
+    /*
+    Runs a grid of (dataset, classifier, hyperparameters, seed, fold) cells on parallel workers.
+    Every worker owns a deque of cells, largest first, and steals from the others when it runs dry.
+    Completed cells are appended to a json lines results file, run() skips the cells already there.
+    */
+    using ClassifierFactory = std::function<std::unique_ptr<PyClassifier>()>;
+    struct ExperimentCell {
+        std::string dataset;
+        std::string model;
+        nlohmann::json hyperparameters;
+        int seed;
+        int fold;
+        double cost; // estimated work, used to schedule largest jobs first
+        std::string key() const;
+    };
+    class Scheduler {
+    public:
+        Scheduler(const std::string& resultsFile, int nWorkers = 0);
+        ~Scheduler();
+        void addDataset(const std::string& name, torch::Tensor& X, torch::Tensor& y);
+        // grid: {"hyperparameter": [values...], ...}, scalars are taken as a single value
+        void addModel(const std::string& name, ClassifierFactory factory, const nlohmann::json& grid = nlohmann::json::object());
+        void setSeeds(const std::vector<int>& seeds);
+        void setFolds(int folds, bool stratified);
+        // Expands the grid, hyperparameters are checked against every classifier's validHyperparameters.
+        // "preprocessing" is valid for every model, each cell fits its pipeline on its training rows
+        std::vector<ExperimentCell> expand();
+        // Fit and score of a cell are stopped after timeout and the cell is recorded with "status": "timeout"
+        void setCellTimeout(std::chrono::milliseconds timeout) { cellTimeout = timeout; }
+        // Runs every pending cell and returns the results of all the cells in the grid. A cell whose fit or
+        // score throws is recorded with "status": "error" and its message in "error", the others go on
+        std::vector<nlohmann::json> run();
+        // Stops the running cells, run() returns the results completed so far and the stopped cells with
+        // "status": "cancelled". Stopped cells aren't checkpointed, they run again next time
+        void cancel();
+    private:
+        struct Dataset {
+            torch::Tensor X, y;
+            CPyObject yp;
+            // X as the cells' classifiers take it, converted once per input dtype (GIL held)
+            std::map<torch::ScalarType, CPyObject> inputs;
+        };
+        struct Model {
+            ClassifierFactory factory;
+            nlohmann::json grid;
+        };
+        struct Split {
+            CPyObject train, test; // numpy index arrays
+            torch::Tensor trainRows; // train indices, to fit the cells' preprocessing pipelines
+        };
+        struct Worker {
+            std::deque<ExperimentCell> cells;
+            std::mutex mutex;
+        };
+        std::vector<nlohmann::json> expandGrid(const nlohmann::json& grid) const;
+        std::set<std::string> loadCheckpoint(std::vector<nlohmann::json>& results);
+        bool nextCell(int worker, ExperimentCell& cell);
+        nlohmann::json runCell(const ExperimentCell& cell);
+        // dataset's X through clf's conversion, shared by the cells whose classifiers take the same dtype.
+        // buffers keeps alive what a sparse X's matrix points to (GIL held)
+        CPyObject cellInput(Dataset& dataset, PyClassifier& clf, std::vector<torch::Tensor>& buffers);
+        std::string resultsFile;
+        int nWorkers;
+        int folds = 5;
+        bool stratified = true;
+        std::vector<int> seeds = { 0 };
+        std::map<std::string, Dataset> datasets;
+        std::map<std::string, Model> models;
+        // (dataset, seed) -> folds' splits
+        std::map<std::pair<std::string, int>, std::vector<Split>> splits;
+        std::vector<std::unique_ptr<Worker>> workers;
+        std::mutex resultsMutex;
+        std::mutex inputsMutex;
+        std::chrono::milliseconds cellTimeout{ 0 };
+        CancellationToken token;
+    };
+} /* namespace pywrap */
+#endif /* SCHEDULER_H */
@@ -0,0 +1,320 @@
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <numeric>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include "Conversion.h"
+#include "Streaming.h"
+
+namespace pywrap {
+    namespace {
+        std::string trim(const std::string& text)
+        {
+            auto first = text.find_first_not_of(" \t\r\n");
+            if (first == std::string::npos) {
+                return "";
+            }
+            auto last = text.find_last_not_of(" \t\r\n");
+            return text.substr(first, last - first + 1);
+        }
+        std::string unquote(const std::string& text)
+        {
+            auto value = trim(text);
+            if (value.size() >= 2 && (value.front() == '\'' || value.front() == '"') && value.back() == value.front()) {
+                return value.substr(1, value.size() - 2);
+            }
+            return value;
+        }
+        bool startsWith(const std::string& line, const std::string& keyword)
+        {
+            if (line.size() < keyword.size()) {
+                return false;
+            }
+            for (size_t i = 0; i < keyword.size(); ++i) {
+                if (std::tolower(static_cast<unsigned char>(line[i])) != keyword[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        // Comma separated values, commas inside quotes don't split
+        std::vector<std::string> splitValues(const std::string& line)
+        {
+            std::vector<std::string> values;
+            std::string current;
+            char quote = 0;
+            for (char c : line) {
+                if (quote != 0) {
+                    if (c == quote) {
+                        quote = 0;
+                    }
+                    current += c;
+                } else if (c == '\'' || c == '"') {
+                    quote = c;
+                    current += c;
+                } else if (c == ',') {
+                    values.push_back(unquote(current));
+                    current.clear();
+                } else {
+                    current += c;
+                }
+            }
+            values.push_back(unquote(current));
+            return values;
+        }
+    }
+    TensorSource::TensorSource(const torch::Tensor& X) : X(X)
+    {
+        if (X.dim() != 2) {
+            throw std::runtime_error("TensorSource: expected a [features, samples] tensor");
+        }
+    }
+    int64_t TensorSource::read(float* rows, int64_t maxRows)
+    {
+        auto count = std::min(maxRows, X.size(1) - position);
+        if (count <= 0) {
+            return 0;
+        }
+        transposeInto(X.narrow(1, position, count), torch::kFloat32, rows);
+        position += count;
+        return count;
+    }
+    ArffSource::ArffSource(const std::string& path, const std::string& classAttribute) : file(path), path(path)
+    {
+        if (!file) {
+            throw std::runtime_error("ArffSource: couldn't open " + path);
+        }
+        std::string line;
+        bool data = false;
+        while (!data && std::getline(file, line)) {
+            lineNumber++;
+            line = trim(line);
+            if (line.empty() || line[0] == '%') {
+                continue;
+            }
+            if (startsWith(line, "@data")) {
+                data = true;
+            } else if (startsWith(line, "@attribute")) {
+                auto rest = trim(line.substr(10));
+                Attribute attribute;
+                size_t end;
+                if (!rest.empty() && (rest[0] == '\'' || rest[0] == '"')) {
+                    end = rest.find(rest[0], 1);
+                    if (end == std::string::npos) {
+                        throw std::runtime_error("ArffSource: unterminated attribute name at line " + std::to_string(lineNumber) + " of " + path);
+                    }
+                    attribute.name = rest.substr(1, end - 1);
+                    end++;
+                } else {
+                    end = rest.find_first_of(" \t");
+                    attribute.name = rest.substr(0, end);
+                }
+                auto type = end == std::string::npos ? "" : trim(rest.substr(end));
+                if (!type.empty() && type[0] == '{') {
+                    auto values = splitValues(type.substr(1, type.find_last_of('}') - 1));
+                    for (size_t i = 0; i < values.size(); ++i) {
+                        attribute.values[values[i]] = static_cast<int>(i);
+                    }
+                } else if (!startsWith(type, "numeric") && !startsWith(type, "real") && !startsWith(type, "integer")) {
+                    throw std::runtime_error("ArffSource: unsupported type of attribute " + attribute.name + " in " + path);
+                }
+                attributes.push_back(attribute);
+            }
+        }
+        if (!data || attributes.empty()) {
+            throw std::runtime_error("ArffSource: no attributes or @data section in " + path);
+        }
+        dataOffset = file.tellg();
+        classIndex = attributes.size() - 1;
+        if (!classAttribute.empty()) {
+            auto found = std::find_if(attributes.begin(), attributes.end(), [&classAttribute](const Attribute& attribute) { return attribute.name == classAttribute; });
+            if (found == attributes.end()) {
+                throw std::runtime_error("ArffSource: class attribute " + classAttribute + " not found in " + path);
+            }
+            classIndex = found - attributes.begin();
+        }
+        for (size_t i = 0; i < attributes.size(); ++i) {
+            if (i != classIndex) {
+                featureNames.push_back(attributes[i].name);
+            }
+        }
+    }
+    int64_t ArffSource::read(float* rows, int64_t maxRows, int32_t* labels)
+    {
+        int64_t count = 0;
+        std::string line;
+        while (count < maxRows && std::getline(file, line)) {
+            lineNumber++;
+            line = trim(line);
+            if (line.empty() || line[0] == '%') {
+                continue;
+            }
+            if (line[0] == '{') {
+                throw std::runtime_error("ArffSource: sparse rows are not supported, line " + std::to_string(lineNumber) + " of " + path);
+            }
+            auto values = splitValues(line);
+            if (values.size() != attributes.size()) {
+                throw std::runtime_error("ArffSource: expected " + std::to_string(attributes.size()) + " values at line " + std::to_string(lineNumber) + " of " + path);
+            }
+            float* row = rows + count * features();
+            for (size_t i = 0, feature = 0; i < values.size(); ++i) {
+                const auto& value = values[i];
+                const auto& attribute = attributes[i];
+                float parsed;
+                if (value == "?") {
+                    parsed = std::numeric_limits<float>::quiet_NaN();
+                } else if (!attribute.values.empty()) {
+                    auto found = attribute.values.find(value);
+                    if (found == attribute.values.end()) {
+                        throw std::runtime_error("ArffSource: unknown value " + value + " of attribute " + attribute.name + " at line " + std::to_string(lineNumber) + " of " + path);
+                    }
+                    parsed = static_cast<float>(found->second);
+                } else {
+                    char* end;
+                    parsed = std::strtof(value.c_str(), &end);
+                    if (end == value.c_str()) {
+                        throw std::runtime_error("ArffSource: bad number " + value + " at line " + std::to_string(lineNumber) + " of " + path);
+                    }
+                }
+                if (i != classIndex) {
+                    row[feature++] = parsed;
+                } else if (labels != nullptr) {
+                    labels[count] = std::isnan(parsed) ? -1 : static_cast<int32_t>(parsed);
+                }
+            }
+            count++;
+        }
+        return count;
+    }
+    std::map<std::string, std::vector<int>> ArffSource::getStates() const
+    {
+        std::map<std::string, std::vector<int>> states;
+        for (const auto& attribute : attributes) {
+            if (!attribute.values.empty()) {
+                std::vector<int> values(attribute.values.size());
+                std::iota(values.begin(), values.end(), 0);
+                states[attribute.name] = values;
+            }
+        }
+        return states;
+    }
+    CsvSource::CsvSource(const std::string& path, const std::string& classColumn) : file(path), path(path)
+    {
+        if (!file) {
+            throw std::runtime_error("CsvSource: couldn't open " + path);
+        }
+        std::string line;
+        while (line.empty() && std::getline(file, line)) {
+            lineNumber++;
+            line = trim(line);
+        }
+        auto names = splitValues(line);
+        if (line.empty() || names.size() < 2) {
+            throw std::runtime_error("CsvSource: expected a header line with the column names in " + path);
+        }
+        dataOffset = file.tellg();
+        columns = names.size();
+        classIndex = columns - 1;
+        if (!classColumn.empty()) {
+            auto found = std::find(names.begin(), names.end(), classColumn);
+            if (found == names.end()) {
+                throw std::runtime_error("CsvSource: class column " + classColumn + " not found in " + path);
+            }
+            classIndex = found - names.begin();
+        }
+        className = names[classIndex];
+        for (size_t i = 0; i < columns; ++i) {
+            if (i != classIndex) {
+                featureNames.push_back(names[i]);
+            }
+        }
+    }
+    int64_t CsvSource::read(float* rows, int64_t maxRows, int32_t* labels)
+    {
+        int64_t count = 0;
+        std::string line;
+        while (count < maxRows && std::getline(file, line)) {
+            lineNumber++;
+            line = trim(line);
+            if (line.empty()) {
+                continue;
+            }
+            auto values = splitValues(line);
+            if (values.size() != columns) {
+                throw std::runtime_error("CsvSource: expected " + std::to_string(columns) + " values at line " + std::to_string(lineNumber) + " of " + path);
+            }
+            float* row = rows + count * features();
+            for (size_t i = 0, feature = 0; i < columns; ++i) {
+                const auto& value = values[i];
+                bool missing = value.empty() || value == "?";
+                if (i == classIndex) {
+                    if (labels != nullptr) {
+                        if (missing) {
+                            labels[count] = -1;
+                        } else {
+                            auto code = classCodes.emplace(value, static_cast<int>(classValues.size()));
+                            if (code.second) {
+                                classValues.push_back(value);
+                            }
+                            labels[count] = code.first->second;
+                        }
+                    }
+                    continue;
+                }
+                if (missing) {
+                    row[feature++] = std::numeric_limits<float>::quiet_NaN();
+                    continue;
+                }
+                char* end;
+                row[feature++] = std::strtof(value.c_str(), &end);
+                if (end == value.c_str()) {
+                    throw std::runtime_error("CsvSource: bad number " + value + " at line " + std::to_string(lineNumber) + " of " + path);
+                }
+            }
+            count++;
+        }
+        return count;
+    }
+    std::map<std::string, std::vector<int>> CsvSource::getStates() const
+    {
+        std::vector<int> values(classValues.size());
+        std::iota(values.begin(), values.end(), 0);
+        return { { className, values } };
+    }
+    CsvSink::CsvSink(const std::string& path) : file(path)
+    {
+        if (!file) {
+            throw std::runtime_error("CsvSink: couldn't create " + path);
+        }
+    }
+    void CsvSink::write(const torch::Tensor& chunk)
+    {
+        std::ostringstream lines;
+        lines << std::setprecision(std::numeric_limits<double>::max_digits10);
+        if (chunk.dim() == 1) {
+            auto labels = chunk.to(torch::kInt64).contiguous();
+            const int64_t* data = labels.data_ptr<int64_t>();
+            for (int64_t row = 0; row < labels.size(0); ++row) {
+                lines << data[row] << '\n';
+            }
+        } else {
+            auto probabilities = chunk.to(torch::kFloat64).contiguous();
+            const double* data = probabilities.data_ptr<double>();
+            auto columns = probabilities.size(1);
+            for (int64_t row = 0; row < probabilities.size(0); ++row) {
+                for (int64_t column = 0; column < columns; ++column) {
+                    lines << (column > 0 ? "," : "") << data[row * columns + column];
+                }
+                lines << '\n';
+            }
+        }
+        file << lines.str();
+        if (!file) {
+            throw std::runtime_error("CsvSink: write failed");
+        }
+    }
+} /* namespace pywrap */
@@ -0,0 +1,132 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+#include <string>
+#include <vector>
+#include <map>
+#include <fstream>
+#include <functional>
+#include <torch/torch.h>
+
+namespace pywrap {
+    /*
+    Sources and sinks of PyClassifier::predictStream. A source is read in order by the stream's reader
+    thread, a sink is written in order by the calling thread: neither has to be thread safe.
+    */
+    class ChunkSource {
+    public:
+        virtual ~ChunkSource() = default;
+        virtual int64_t features() const = 0;
+        // Fills rows, row major [maxRows, features], returns the rows read, 0 once the source is done
+        virtual int64_t read(float* rows, int64_t maxRows) = 0;
+    };
+    class PredictionSink {
+    public:
+        virtual ~PredictionSink() = default;
+        // Predictions of one chunk: labels [rows] int32 or probabilities [rows, classes] float64
+        virtual void write(const torch::Tensor& chunk) = 0;
+    };
+    class CallbackSource : public ChunkSource {
+    public:
+        CallbackSource(int64_t features, std::function<int64_t(float*, int64_t)> reader) : nFeatures(features), reader(std::move(reader)) {}
+        int64_t features() const override { return nFeatures; }
+        int64_t read(float* rows, int64_t maxRows) override { return reader(rows, maxRows); }
+    private:
+        int64_t nFeatures;
+        std::function<int64_t(float*, int64_t)> reader;
+    };
+    // Samples of an in memory [features, samples] tensor
+    class TensorSource : public ChunkSource {
+    public:
+        explicit TensorSource(const torch::Tensor& X);
+        int64_t features() const override { return X.size(0); }
+        int64_t read(float* rows, int64_t maxRows) override;
+    private:
+        torch::Tensor X;
+        int64_t position = 0;
+    };
+    // Sources that also read the class of every row
+    class LabeledSource : public ChunkSource {
+    public:
+        int64_t read(float* rows, int64_t maxRows) override { return read(rows, maxRows, nullptr); }
+        // labels [maxRows] gets the class of every row read, -1 where it is missing. nullptr skips them
+        virtual int64_t read(float* rows, int64_t maxRows, int32_t* labels) = 0;
+        virtual const std::vector<std::string>& getFeatures() const = 0;
+        virtual const std::string& getClassName() const = 0;
+        // States of the nominal features and of the class, as far as the rows read tell
+        virtual std::map<std::string, std::vector<int>> getStates() const = 0;
+    };
+    // ARFF file read as it goes: numeric attributes as they are, nominal ones as the index of their
+    // value and missing values as NaN. The class attribute (the last one unless named) is left out
+    class ArffSource : public LabeledSource {
+    public:
+        struct Attribute {
+            std::string name;
+            std::map<std::string, int, std::less<>> values; // empty for numeric attributes
+        };
+        explicit ArffSource(const std::string& path, const std::string& classAttribute = "");
+        using LabeledSource::read;
+        int64_t features() const override { return static_cast<int64_t>(featureNames.size()); }
+        int64_t read(float* rows, int64_t maxRows, int32_t* labels) override;
+        const std::vector<std::string>& getFeatures() const override { return featureNames; }
+        const std::string& getClassName() const override { return attributes[classIndex].name; }
+        std::map<std::string, std::vector<int>> getStates() const override;
+        // Schema, for readers of the data section on their own
+        const std::vector<Attribute>& getAttributes() const { return attributes; }
+        size_t getClassIndex() const { return classIndex; }
+        // File offset of the first line after @data
+        std::streamoff getDataOffset() const { return dataOffset; }
+    private:
+        std::ifstream file;
+        std::string path;
+        std::vector<Attribute> attributes;
+        std::vector<std::string> featureNames;
+        size_t classIndex;
+        std::streamoff dataOffset;
+        int64_t lineNumber = 0;
+    };
+    // CSV file with a header line of column names. Every column is numeric but the class one (the
+    // last unless named), whose values are numbered in order of appearance. Empty and ? values are NaN
+    class CsvSource : public LabeledSource {
+    public:
+        explicit CsvSource(const std::string& path, const std::string& classColumn = "");
+        using LabeledSource::read;
+        int64_t features() const override { return static_cast<int64_t>(featureNames.size()); }
+        int64_t read(float* rows, int64_t maxRows, int32_t* labels) override;
+        const std::vector<std::string>& getFeatures() const override { return featureNames; }
+        const std::string& getClassName() const override { return className; }
+        std::map<std::string, std::vector<int>> getStates() const override;
+        // Class values in the order they were numbered
+        const std::vector<std::string>& getClassValues() const { return classValues; }
+        size_t getColumns() const { return columns; }
+        size_t getClassIndex() const { return classIndex; }
+        // File offset of the first line after the header
+        std::streamoff getDataOffset() const { return dataOffset; }
+    private:
+        std::ifstream file;
+        std::string path;
+        std::vector<std::string> featureNames;
+        std::string className;
+        size_t columns;
+        size_t classIndex;
+        std::streamoff dataOffset;
+        std::map<std::string, int> classCodes;
+        std::vector<std::string> classValues;
+        int64_t lineNumber = 0;
+    };
+    class CallbackSink : public PredictionSink {
+    public:
+        explicit CallbackSink(std::function<void(const torch::Tensor&)> writer) : writer(std::move(writer)) {}
+        void write(const torch::Tensor& chunk) override { writer(chunk); }
+    private:
+        std::function<void(const torch::Tensor&)> writer;
+    };
+    // One line per row: the label, or the probabilities of the classes comma separated
+    class CsvSink : public PredictionSink {
+    public:
+        explicit CsvSink(const std::string& path);
+        void write(const torch::Tensor& chunk) override;
+    private:
+        std::ofstream file;
+    };
+} /* namespace pywrap */
+#endif /* STREAMING_H */
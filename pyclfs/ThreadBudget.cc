@@ -0,0 +1,47 @@
+#include <thread>
+#include <algorithm>
+#include "ThreadBudget.h"
+
+namespace pywrap {
+    ThreadBudget::ThreadBudget(int threads)
+    {
+        setThreads(threads);
+    }
+    void ThreadBudget::setThreads(int threads)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            this->threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+        }
+        released.notify_all();
+    }
+    int ThreadBudget::getThreads() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return threads;
+    }
+    int ThreadBudget::inUse() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return used;
+    }
+    int ThreadBudget::acquire(int requested)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        callers++;
+        released.wait(lock, [this]() { return used < threads; });
+        int share = requested > 0 ? requested : std::max(1, threads / callers);
+        int granted = std::min(share, threads - used);
+        used += granted;
+        return granted;
+    }
+    void ThreadBudget::release(int threads)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            used -= threads;
+            callers--;
+        }
+        released.notify_all();
+    }
+} /* namespace pywrap */
@@ -0,0 +1,31 @@
+#ifndef THREADBUDGET_H
+#define THREADBUDGET_H
+#include <mutex>
+#include <condition_variable>
+
+namespace pywrap {
+    /*
+    Process wide CPU budget shared by every fit/predict call.
+    A call gets a fair share of the budget (budget / concurrent callers, at least one thread)
+    and waits while the whole budget is handed out.
+    */
+    class ThreadBudget {
+    public:
+        explicit ThreadBudget(int threads = 0);
+        ~ThreadBudget() = default;
+        // threads <= 0 means all the hardware threads
+        void setThreads(int threads);
+        int getThreads() const;
+        int inUse() const;
+        // requested <= 0 asks for the fair share, returns the number of threads granted
+        int acquire(int requested = 0);
+        void release(int threads);
+    private:
+        mutable std::mutex mutex;
+        std::condition_variable released;
+        int threads;
+        int used = 0;
+        int callers = 0;
+    };
+} /* namespace pywrap */
+#endif /* THREADBUDGET_H */
@@ -1,10 +1,62 @@
+#include <algorithm>
 #include "XGBoost.h"
 
 //See https ://stackoverflow.com/questions/36071672/using-xgboost-in-c
 namespace pywrap {
     XGBoost::XGBoost() : PyClassifier("xgboost", "XGBClassifier", true)
     {
-        validHyperparameters = { "tree_method", "early_stopping_rounds", "n_jobs" };
+        validHyperparameters = { "tree_method", "early_stopping_rounds", "n_jobs", "enable_categorical", "max_cat_to_onehot", "max_cat_threshold" };
+        sparseInput = true;
         xgboost = true;
+        growth = Growth::Continuation;
     }
-} /* namespace pywrap */
\ No newline at end of file
+    void XGBoost::prepareStates(const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states)
+    {
+        notes.erase(std::remove_if(notes.begin(), notes.end(), [](const std::string& note) { return note.rfind("Categorical features:", 0) == 0; }), notes.end());
+        // Opt in: enable_categorical true turns the features with states into categorical ones
+        bool enabled = false;
+        if (hyperparameters.contains("enable_categorical")) {
+            if (!hyperparameters["enable_categorical"].is_boolean()) {
+                throw PyWrapException("enable_categorical must be a boolean, got " + hyperparameters["enable_categorical"].dump());
+            }
+            enabled = hyperparameters["enable_categorical"].get<bool>();
+        }
+        // A pipeline changes the columns and their values, the states no longer describe what xgboost gets
+        enabled = enabled && getPreprocessing().empty();
+        if (!enabled) {
+            if (categoricalSet) {
+                setAttributes({ { "enable_categorical", false }, { "feature_types", nullptr } });
+                categoricalSet = false;
+            }
+            return;
+        }
+        // Discretized features are category codes 0..states-1, xgboost splits them by partition instead of by order
+        auto types = nlohmann::json::array();
+        int categorical = 0;
+        for (const auto& feature : features) {
+            auto item = states.find(feature);
+            if (item != states.end() && !item->second.empty()) {
+                types.push_back("c");
+                categorical++;
+            } else {
+                types.push_back("q");
+            }
+        }
+        if (categorical == 0) {
+            if (categoricalSet) {
+                // Back to plain numeric input after a categorical fit
+                setAttributes({ { "enable_categorical", false }, { "feature_types", nullptr } });
+                categoricalSet = false;
+            }
+            return;
+        }
+        nlohmann::json attributes = { { "enable_categorical", true }, { "feature_types", types } };
+        if (!hyperparameters.contains("tree_method")) {
+            // Categorical splits need hist or approx, exact is the default of older versions
+            attributes["tree_method"] = "hist";
+        }
+        setAttributes(attributes);
+        categoricalSet = true;
+        notes.push_back("Categorical features: " + std::to_string(categorical) + " of " + std::to_string(features.size()));
+    }
+} /* namespace pywrap */
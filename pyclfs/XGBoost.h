@@ -7,6 +7,12 @@ namespace pywrap {
     public:
         XGBoost();
         ~XGBoost() = default;
+    protected:
+        // With enable_categorical true and no preprocessing pipeline, features with states go in as
+        // categorical (feature_types 'c')
+        void prepareStates(const std::vector<std::string>& features, const std::map<std::string, std::vector<int>>& states) override;
+    private:
+        bool categoricalSet = false;
     };
 } /* namespace pywrap */
-#endif /* XGBOOST_H */
\ No newline at end of file
+#endif /* XGBOOST_H */
@@ -0,0 +1,280 @@
+// Load test for concurrent predict throughput through PyWrap
+//
+// Usage: load_test_pyclassifiers [options]
+//   --model <STree|ODTE|SVC|RandomForest|XGBoost|AdaBoost>  (default STree)
+//   --dataset <name>        dataset in tests/data (default iris)
+//   --threads <list>        comma separated thread counts (default 1,2,4,8)
+//   --shared                all threads share one fitted classifier (default one per thread)
+//   --rate <n>              total requests per second, 0 = as fast as possible (default 0)
+//   --duration <seconds>    duration of every step (default 5)
+//   --batch <n>             rows per predict request (default 1)
+//   --soak                  print RSS samples during the run to spot leaks
+//   --row                   single row requests through predictRow (implies --batch 1)
+//   --gc <policy>           default, freeze, deferred or disabled (default default)
+//   --preload <list>        comma separated modules imported in background at startup
+//   --isolated              start the interpreter in isolated mode
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "pyclfs/STree.h"
+#include "pyclfs/ODTE.h"
+#include "pyclfs/SVC.h"
+#include "pyclfs/RandomForest.h"
+#include "pyclfs/XGBoost.h"
+#include "pyclfs/AdaBoostPy.h"
+#include "TestUtils.h"
+
+using clock_type = std::chrono::steady_clock;
+
+struct Options {
+    std::string model = "STree";
+    std::string dataset = "iris";
+    std::vector<int> threads = { 1, 2, 4, 8 };
+    bool shared = false;
+    double rate = 0;
+    double duration = 5;
+    int batch = 1;
+    bool soak = false;
+    bool row = false;
+    pywrap::GcPolicy gc = pywrap::GcPolicy::Default;
+    pywrap::InterpreterConfig interpreter;
+};
+
+struct StepResult {
+    int threads;
+    uint64_t requests;
+    uint64_t errors;
+    double seconds;
+    std::vector<double> latencies; // microseconds
+    long rssStart, rssEnd, rssPeak; // KiB
+};
+
+long currentRSS()
+{
+#ifdef __linux__
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    if (statm >> pages >> resident) {
+        return resident * (sysconf(_SC_PAGESIZE) / 1024);
+    }
+    return 0;
+#else
+    // Only the peak is available outside linux
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024;
+#endif
+}
+
+std::unique_ptr<pywrap::PyClassifier> buildModel(const std::string& name)
+{
+    if (name == "STree") return std::make_unique<pywrap::STree>();
+    if (name == "ODTE") return std::make_unique<pywrap::ODTE>();
+    if (name == "SVC") return std::make_unique<pywrap::SVC>();
+    if (name == "RandomForest") return std::make_unique<pywrap::RandomForest>();
+    if (name == "XGBoost") return std::make_unique<pywrap::XGBoost>();
+    if (name == "AdaBoost") return std::make_unique<pywrap::AdaBoostPy>();
+    throw std::invalid_argument("Unknown model: " + name);
+}
+
+Options parseArguments(int argc, char** argv)
+{
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.empty()) {
+            continue;
+        }
+        auto value = [&]() -> std::string {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return argv[++i];
+        };
+        if (arg == "--model") {
+            options.model = value();
+        } else if (arg == "--dataset") {
+            options.dataset = value();
+        } else if (arg == "--threads") {
+            options.threads.clear();
+            std::stringstream list(value());
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.threads.push_back(std::stoi(item));
+            }
+        } else if (arg == "--shared") {
+            options.shared = true;
+        } else if (arg == "--rate") {
+            options.rate = std::stod(value());
+        } else if (arg == "--duration") {
+            options.duration = std::stod(value());
+        } else if (arg == "--batch") {
+            options.batch = std::stoi(value());
+        } else if (arg == "--soak") {
+            options.soak = true;
+        } else if (arg == "--gc") {
+            static const std::map<std::string, pywrap::GcPolicy> policies = {
+                { "default", pywrap::GcPolicy::Default }, { "freeze", pywrap::GcPolicy::Freeze },
+                { "deferred", pywrap::GcPolicy::Deferred }, { "disabled", pywrap::GcPolicy::Disabled }
+            };
+            auto policy = policies.find(value());
+            if (policy == policies.end()) {
+                throw std::invalid_argument("Unknown gc policy");
+            }
+            options.gc = policy->second;
+        } else if (arg == "--preload") {
+            std::stringstream list(value());
+            std::string item;
+            while (std::getline(list, item, ',')) {
+                options.interpreter.preload.push_back(item);
+            }
+        } else if (arg == "--isolated") {
+            options.interpreter.isolated = true;
+        } else if (arg == "--row") {
+            options.row = true;
+            options.batch = 1;
+        } else {
+            throw std::invalid_argument("Unknown option: " + arg);
+        }
+    }
+    return options;
+}
+
+double percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+    auto index = static_cast<size_t>(p / 100.0 * (sorted.size() - 1));
+    return sorted[index];
+}
+
+StepResult runStep(const Options& options, int nThreads, std::vector<pywrap::PyClassifier*>& models, torch::Tensor& X)
+{
+    StepResult result{ nThreads, 0, 0, 0.0, {}, currentRSS(), 0, 0 };
+    std::atomic<bool> stop{ false };
+    std::atomic<uint64_t> errors{ 0 };
+    std::vector<std::vector<double>> latencies(nThreads);
+    std::vector<uint64_t> requests(nThreads, 0);
+    // Every thread gets its own slice of the rate budget
+    auto interval = options.rate > 0 ? std::chrono::duration<double>(nThreads / options.rate) : std::chrono::duration<double>(0);
+    auto worker = [&](int thread) {
+        auto clf = options.shared ? models[0] : models[thread];
+        auto Xb = X.clone();
+        auto row = X.to(torch::kFloat64).contiguous();
+        auto next = clock_type::now();
+        while (!stop.load(std::memory_order_relaxed)) {
+            if (options.rate > 0) {
+                std::this_thread::sleep_until(next);
+                next += std::chrono::duration_cast<clock_type::duration>(interval);
+            }
+            auto start = clock_type::now();
+            try {
+                if (options.row) {
+                    clf->predictRow(row.data_ptr<double>());
+                } else {
+                    clf->predict(Xb);
+                }
+            }
+            catch (const std::exception& e) {
+                errors++;
+            }
+            auto elapsed = std::chrono::duration<double, std::micro>(clock_type::now() - start).count();
+            latencies[thread].push_back(elapsed);
+            requests[thread]++;
+        }
+    };
+    // RSS sampler, also reports the trajectory in soak mode
+    std::atomic<long> peak{ result.rssStart };
+    auto sampler = std::thread([&]() {
+        auto begin = clock_type::now();
+        while (!stop.load()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(500));
+            auto rss = currentRSS();
+            if (rss > peak.load()) {
+                peak = rss;
+            }
+            if (options.soak) {
+                auto elapsed = std::chrono::duration<double>(clock_type::now() - begin).count();
+                std::cout << "  [" << std::fixed << std::setprecision(1) << elapsed << "s] rss=" << rss << " KiB" << std::endl;
+            }
+        }
+    });
+    auto start = clock_type::now();
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nThreads; ++i) {
+        threads.emplace_back(worker, i);
+    }
+    std::this_thread::sleep_for(std::chrono::duration<double>(options.duration));
+    stop = true;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    result.seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    sampler.join();
+    for (int i = 0; i < nThreads; ++i) {
+        result.requests += requests[i];
+        result.latencies.insert(result.latencies.end(), latencies[i].begin(), latencies[i].end());
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    result.errors = errors;
+    result.rssEnd = currentRSS();
+    result.rssPeak = std::max(peak.load(), result.rssEnd);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try {
+        options = parseArguments(argc, argv);
+    }
+    catch (const std::exception& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    auto wrap = pywrap::PyWrap::Initialize(options.interpreter);
+    wrap->setGcPolicy(options.gc);
+    auto raw = RawDatasets(options.dataset, false);
+    auto batch = std::min(options.batch, raw.nSamples);
+    // [features, batch] slice made contiguous once, so requests only measure the wrapper
+    auto X = raw.Xt.slice(1, 0, batch).contiguous();
+    wrap->waitForPreload();
+    std::cout << "startup: " << wrap->startupReport().dump() << std::endl;
+    auto maxThreads = *std::max_element(options.threads.begin(), options.threads.end());
+    std::vector<std::unique_ptr<pywrap::PyClassifier>> owners;
+    std::vector<pywrap::PyClassifier*> models;
+    auto nModels = options.shared ? 1 : maxThreads;
+    for (int i = 0; i < nModels; ++i) {
+        owners.push_back(buildModel(options.model));
+        owners.back()->fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        models.push_back(owners.back().get());
+    }
+    std::cout << "Model: " << options.model << " Dataset: " << options.dataset << " Batch: " << batch
+        << " Mode: " << (options.shared ? "shared" : "per-thread") << (options.row ? " row" : "") << " Rate: " << (options.rate > 0 ? std::to_string(options.rate) + " req/s" : "max") << std::endl;
+    std::cout << std::setw(8) << "threads" << std::setw(11) << "requests" << std::setw(8) << "errors" << std::setw(13) << "req/s"
+        << std::setw(11) << "p50 ms" << std::setw(11) << "p95 ms" << std::setw(11) << "p99 ms" << std::setw(11) << "p999 ms"
+        << std::setw(13) << "rss KiB" << std::setw(13) << "peak KiB" << std::setw(11) << "growth" << std::endl;
+    for (auto nThreads : options.threads) {
+        auto step = runStep(options, nThreads, models, X);
+        std::cout << std::fixed << std::setw(8) << step.threads << std::setw(11) << step.requests << std::setw(8) << step.errors
+            << std::setw(13) << std::setprecision(1) << step.requests / step.seconds
+            << std::setprecision(3) << std::setw(11) << percentile(step.latencies, 50) / 1000 << std::setw(11) << percentile(step.latencies, 95) / 1000
+            << std::setw(11) << percentile(step.latencies, 99) / 1000 << std::setw(11) << percentile(step.latencies, 99.9) / 1000
+            << std::setw(13) << step.rssEnd << std::setw(13) << step.rssPeak << std::setw(11) << step.rssEnd - step.rssStart << std::endl;
+    }
+    std::cout << "gc: " << wrap->metrics()["gc"].dump() << std::endl;
+    return 0;
+}
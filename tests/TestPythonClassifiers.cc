@@ -2,6 +2,11 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/catch_approx.hpp>
 #include <catch2/generators/catch_generators.hpp>
@@ -12,7 +17,16 @@
 #include "pyclfs/XGBoost.h"
 #include "pyclfs/AdaBoostPy.h"
 #include "pyclfs/ODTE.h"
+#include "pyclfs/Conversion.h"
+#include "pyclfs/Metrics.h"
+#include "pyclfs/Streaming.h"
+#include "pyclfs/Dataset.h"
+#include "pyclfs/Loader.h"
+#include "pyclfs/Preprocessing.h"
+#include "pyclfs/CrossValidation.h"
+#include "pyclfs/Scheduler.h"
 #include "TestUtils.h"
+#include "SourceData.h"
 #include <iostream>
 
 TEST_CASE("Test Python Classifiers score", "[PyClassifiers]")
@@ -77,6 +91,14 @@ TEST_CASE("Classifiers features", "[PyClassifiers]")
     REQUIRE(clf.getNumberOfNodes() == 5);
     REQUIRE(clf.getNumberOfEdges() == 3);
 }
+TEST_CASE("Python errors", "[PyClassifiers]")
+{
+    // The GIL isn't held between calls, failed Python calls come back as exceptions
+    REQUIRE_THROWS_AS(pywrap::PyClassifier("sklearn.svm", "Nothing"), pywrap::PyWrapException);
+    auto clf = pywrap::RandomForest();
+    REQUIRE_THROWS_AS(clf.callMethodSumOfItems("node_count"), pywrap::PyWrapException);
+    REQUIRE_THROWS_AS(clf.callMethodInt("nonexistent_method"), pywrap::PyWrapException);
+}
 TEST_CASE("Get num features & num edges", "[PyClassifiers]")
 {
     auto estimators = nlohmann::json::parse("{ \"n_estimators\": 10 }");
@@ -153,4 +175,790 @@ TEST_CASE("XGBoost predict proba", "[PyClassifiers]")
         REQUIRE(torch::argmax(predict_proba[row]).item<int>() == predict[row].item<int>());
         REQUIRE(torch::sum(predict_proba[row]).item<double>() == Catch::Approx(1.0).epsilon(raw.epsilon));
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Cross validation", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto clf = pywrap::STree();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"random_state\": 0 }"));
+    auto stratified = GENERATE(true, false);
+    auto parallel = pywrap::crossValidate(clf, raw.Xt, raw.yt, 5, stratified, 271, true);
+    auto sequential = pywrap::crossValidate(clf, raw.Xt, raw.yt, 5, stratified, 271, false);
+    REQUIRE(parallel.size() == 5);
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(parallel[i].fold == i);
+        REQUIRE(parallel[i].score > 0.8);
+        REQUIRE(parallel[i].score <= 1.0);
+        REQUIRE(parallel[i].fitTime >= 0.0);
+        REQUIRE(parallel[i].score == Catch::Approx(sequential[i].score).epsilon(raw.epsilon));
+    }
+    // Sample major X is handed over as it is, the folds see the same data
+    auto Xs = raw.Xt.t().contiguous().t();
+    auto sampleMajor = pywrap::crossValidate(clf, Xs, raw.yt, 5, stratified, 271, false);
+    for (int i = 0; i < 5; ++i) {
+        REQUIRE(sampleMajor[i].score == Catch::Approx(sequential[i].score).epsilon(raw.epsilon));
+    }
+}
+TEST_CASE("Experiment scheduler", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto resultsFile = (std::filesystem::temp_directory_path() / "pyclassifiers_scheduler.json").string();
+    std::filesystem::remove(resultsFile);
+    auto build = [&]() {
+        auto scheduler = std::make_unique<pywrap::Scheduler>(resultsFile, 2);
+        scheduler->addDataset("iris", raw.Xt, raw.yt);
+        scheduler->addModel("STree", []() { return std::make_unique<pywrap::STree>(); }, nlohmann::json::parse("{ \"C\": [1.0, 10.0] }"));
+        scheduler->setFolds(3, true);
+        return scheduler;
+    };
+    SECTION("Runs and resumes from checkpoint")
+    {
+        auto scheduler = build();
+        REQUIRE(scheduler->expand().size() == 6);
+        auto results = scheduler->run();
+        REQUIRE(results.size() == 6);
+        for (const auto& result : results) {
+            REQUIRE(result["score"].get<double>() > 0.8);
+        }
+        // Nothing left to run, the results come from the checkpoint file
+        auto resumed = build()->run();
+        REQUIRE(resumed.size() == 6);
+    }
+    SECTION("Invalid hyperparameter")
+    {
+        auto scheduler = std::make_unique<pywrap::Scheduler>(resultsFile, 2);
+        scheduler->addModel("SVC", []() { return std::make_unique<pywrap::SVC>(); }, nlohmann::json::parse("{ \"max_depth\": [1, 2] }"));
+        REQUIRE_THROWS_AS(scheduler->expand(), pywrap::PyWrapException);
+    }
+    SECTION("Failing cells are recorded")
+    {
+        auto scheduler = std::make_unique<pywrap::Scheduler>(resultsFile, 2);
+        scheduler->addDataset("iris", raw.Xt, raw.yt);
+        scheduler->addModel("SVC", []() { return std::make_unique<pywrap::SVC>(); }, nlohmann::json::parse("{ \"kernel\": [\"linear\", \"unknown\"] }"));
+        scheduler->setFolds(3, true);
+        auto results = scheduler->run();
+        REQUIRE(results.size() == 6);
+        int errors = 0;
+        for (const auto& result : results) {
+            if (result["hyperparameters"]["kernel"] == "unknown") {
+                REQUIRE(result["status"] == "error");
+                REQUIRE(result["score"].is_null());
+                errors++;
+            } else {
+                REQUIRE(result["score"].get<double>() > 0.8);
+            }
+        }
+        REQUIRE(errors == 3);
+    }
+    SECTION("Models of different input dtypes share the dataset")
+    {
+        // Sample major X is kept as given: a view for the forest, one float64 conversion for both STree cells
+        auto Xs = raw.Xt.t().contiguous().t();
+        auto scheduler = std::make_unique<pywrap::Scheduler>(resultsFile, 2);
+        scheduler->addDataset("iris", Xs, raw.yt);
+        scheduler->addModel("STree", []() { return std::make_unique<pywrap::STree>(); }, nlohmann::json::parse("{ \"C\": [1.0, 10.0] }"));
+        scheduler->addModel("RandomForest", []() { return std::make_unique<pywrap::RandomForest>(); }, nlohmann::json::parse("{ \"n_estimators\": 10 }"));
+        scheduler->setFolds(3, true);
+        auto results = scheduler->run();
+        REQUIRE(results.size() == 9);
+        for (const auto& result : results) {
+            REQUIRE_FALSE(result.contains("status"));
+            REQUIRE(result["score"].get<double>() > 0.8);
+        }
+    }
+    SECTION("Preprocessing in the grid")
+    {
+        auto scheduler = std::make_unique<pywrap::Scheduler>(resultsFile, 2);
+        scheduler->addDataset("iris", raw.Xt, raw.yt);
+        auto grid = nlohmann::json::parse(R"({ "preprocessing": [[ { "step": "select", "features": [2, 3] }, { "step": "standard" } ]] })");
+        scheduler->addModel("SVC", []() { return std::make_unique<pywrap::SVC>(); }, grid);
+        scheduler->setFolds(3, true);
+        auto results = scheduler->run();
+        REQUIRE(results.size() == 3);
+        for (const auto& result : results) {
+            REQUIRE_FALSE(result.contains("status"));
+            REQUIRE(result["score"].get<double>() > 0.8);
+        }
+    }
+    std::filesystem::remove(resultsFile);
+}
+TEST_CASE("Thread budget", "[PyClassifiers]")
+{
+    SECTION("Fair share of the budget")
+    {
+        auto intraOp = at::get_num_threads();
+        auto budget = pywrap::ThreadBudget(4);
+        // A standalone budget leaves libtorch's pool alone
+        REQUIRE(at::get_num_threads() == intraOp);
+        auto first = budget.acquire();
+        REQUIRE(first == 4);
+        REQUIRE(budget.inUse() == 4);
+        budget.release(first);
+        REQUIRE(budget.acquire(3) == 3);
+        // Two callers now, the second one gets what is left
+        REQUIRE(budget.acquire() == 1);
+        budget.release(1);
+        budget.release(3);
+        REQUIRE(budget.inUse() == 0);
+    }
+    SECTION("Classifiers under the budget")
+    {
+        auto raw = RawDatasets("iris", false);
+        auto pyWrap = pywrap::PyWrap::GetInstance();
+        auto intraOp = at::get_num_threads();
+        pyWrap->setThreadBudget(2);
+        REQUIRE(pyWrap->getThreadBudget() == 2);
+        REQUIRE(at::get_num_threads() == 2);
+        auto clf = pywrap::RandomForest();
+        clf.setHyperparameters(nlohmann::json::parse("{ \"random_state\": 0 }"));
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        auto score = clf.score(raw.Xt, raw.yt);
+        pyWrap->setThreadBudget(0);
+        REQUIRE(pyWrap->getThreadBudget() == 0);
+        REQUIRE(at::get_num_threads() == intraOp);
+        REQUIRE(score == Catch::Approx(1.0).epsilon(raw.epsilon));
+    }
+}
+TEST_CASE("Classifier placement", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto clf = pywrap::STree();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"random_state\": 0 }"));
+    clf.setPlacement(pywrap::Placement::cpuSet({ 0 }));
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto score = clf.score(raw.Xt, raw.yt);
+    REQUIRE(score == Catch::Approx(0.99333).epsilon(raw.epsilon));
+    auto notes = clf.getNotes();
+    REQUIRE(std::find(notes.begin(), notes.end(), "Placement: cpus 0") != notes.end());
+    auto report = clf.placementReport();
+    REQUIRE(report["cpus"] == nlohmann::json::array({ 0 }));
+#ifdef __linux__
+    REQUIRE(report["pinned_calls"].get<int>() == 2);
+#endif
+    REQUIRE_THROWS_AS(pywrap::Placement::numaNode(pywrap::Placement::numaNodes() + 1), std::invalid_argument);
+#ifdef __linux__
+    if (!pywrap::Placement::nodeCpus(0).empty()) {
+        // Only the converted arrays are allocated on the node, once: score reuses the one fit converted
+        auto local = pywrap::STree();
+        local.setHyperparameters(nlohmann::json::parse("{ \"random_state\": 0 }"));
+        local.setPlacement(pywrap::Placement::numaNode(0));
+        local.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(local.score(raw.Xt, raw.yt) == Catch::Approx(0.99333).epsilon(raw.epsilon));
+        auto localReport = local.placementReport();
+        REQUIRE(localReport["numa_node"] == 0);
+        REQUIRE(localReport["pinned_calls"].get<int>() == 2);
+        REQUIRE(localReport["node_local_bytes"].get<int64_t>() == raw.Xt.numel() * 8);
+        REQUIRE(local.conversionCacheReport()["hits"].get<int>() >= 1);
+        // Sample major float32 X is a view for the forest, nothing is copied
+        auto forest = pywrap::RandomForest();
+        forest.setPlacement(pywrap::Placement::numaNode(0));
+        auto Xs = raw.Xt.t().contiguous().t();
+        forest.fit(Xs, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(forest.score(Xs, raw.yt) > 0.9f);
+        REQUIRE(forest.placementReport()["node_local_bytes"] == 0);
+    }
+#endif
+}
+TEST_CASE("Vector overloads", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    SECTION("Score matches the tensor path")
+    {
+        auto clf = pywrap::SVC();
+        clf.fit(raw.Xv, raw.yv, raw.featuresv, raw.classNamev, raw.statesv);
+        auto score = clf.score(raw.Xv, raw.yv);
+        REQUIRE(score == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    }
+    SECTION("predict and predict_proba")
+    {
+        auto clf = pywrap::STree();
+        clf.fit(raw.Xv, raw.yv, raw.featuresv, raw.classNamev, raw.statesv);
+        auto predictions = clf.predict(raw.Xv);
+        auto probabilities = clf.predict_proba(raw.Xv);
+        REQUIRE(predictions.size() == raw.yv.size());
+        REQUIRE(probabilities.size() == raw.yv.size());
+        for (size_t i = 0; i < predictions.size(); ++i) {
+            auto row = probabilities[i];
+            REQUIRE(row.size() == raw.classNumStates);
+            REQUIRE(std::distance(row.begin(), std::max_element(row.begin(), row.end())) == predictions[i]);
+        }
+    }
+}
+TEST_CASE("Fit with dataset and sample weights", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::SVC();
+    SECTION("Dataset without weights")
+    {
+        clf.fit(raw.dataset, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(clf.score(raw.Xt, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    }
+    SECTION("Unit weights give the unweighted model")
+    {
+        // SVC scales C by the weights, so 1.0 and not raw.weights' 1/n
+        auto weights = torch::ones({ raw.nSamples }, torch::kDouble);
+        clf.fit(raw.dataset, raw.featurest, raw.classNamet, raw.statest, weights);
+        REQUIRE(clf.score(raw.Xt, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    }
+    SECTION("Wrong weights size")
+    {
+        auto weights = torch::ones({ raw.nSamples - 1 }, torch::kDouble);
+        REQUIRE_THROWS_AS(clf.fit(raw.dataset, raw.featurest, raw.classNamet, raw.statest, weights), std::runtime_error);
+    }
+}
+TEST_CASE("Narrow integer input", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    REQUIRE(pywrap::narrowestDtype(raw.featurest, raw.statest) == torch::kUInt8);
+    auto dtype = GENERATE(torch::kUInt8, torch::kInt16, torch::kInt32);
+    auto X = raw.Xt.to(dtype);
+    auto clf = pywrap::SVC();
+    clf.fit(X, raw.yt);
+    REQUIRE(clf.score(X, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    // With states the input is narrowed automatically
+    clf.fit(X, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE(clf.score(X, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    // The weighted dataset fit takes the same path
+    auto dataset = torch::cat({ X, raw.yt.to(dtype).unsqueeze(0) }, 0);
+    auto weights = torch::ones({ raw.nSamples }, torch::kDouble);
+    clf.fit(dataset, raw.featurest, raw.classNamet, raw.statest, weights);
+    REQUIRE(clf.score(X, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+}
+TEST_CASE("Sparse input", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto layout = GENERATE(torch::kSparse, torch::kSparseCsr, torch::kSparseCsc);
+    torch::Tensor X;
+    if (layout == torch::kSparse) {
+        X = raw.Xt.to_sparse();
+    } else if (layout == torch::kSparseCsr) {
+        X = raw.Xt.to_sparse_csr();
+    } else {
+        X = raw.Xt.to_sparse_csc();
+    }
+    auto clf = pywrap::SVC();
+    clf.fit(X, raw.yt);
+    REQUIRE(clf.score(X, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    auto predictions = clf.predict(X);
+    REQUIRE(torch::equal(predictions, clf.predict(raw.Xt)));
+    auto stree = pywrap::STree();
+    REQUIRE_THROWS_WITH(stree.fit(X, raw.yt), "stree:Stree doesn't accept sparse input");
+}
+TEST_CASE("XGBoost categorical features", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::XGBoost();
+    SECTION("Features with states are categorical")
+    {
+        clf.setHyperparameters(nlohmann::json::parse("{ \"enable_categorical\": true }"));
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        auto notes = clf.getNotes();
+        REQUIRE(std::find(notes.begin(), notes.end(), "Categorical features: 4 of 4") != notes.end());
+        REQUIRE(clf.score(raw.Xt, raw.yt) >= 0.95f);
+    }
+    SECTION("Numeric by default")
+    {
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(clf.getNotes().empty());
+        REQUIRE(clf.score(raw.Xt, raw.yt) == Catch::Approx(0.98).epsilon(raw.epsilon));
+    }
+    SECTION("Numeric under a preprocessing pipeline")
+    {
+        clf.setHyperparameters(nlohmann::json::parse(R"({ "enable_categorical": true, "preprocessing": [ { "step": "select", "features": [2, 3] }, { "step": "standard" } ] })"));
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(clf.getNotes().empty());
+        REQUIRE(clf.score(raw.Xt, raw.yt) >= 0.9f);
+    }
+    SECTION("Invalid enable_categorical")
+    {
+        clf.setHyperparameters(nlohmann::json::parse("{ \"enable_categorical\": \"yes\" }"));
+        REQUIRE_THROWS_AS(clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest), pywrap::PyWrapException);
+    }
+    SECTION("Non string feature_types")
+    {
+        clf.setHyperparameters(nlohmann::json::parse("{ \"feature_types\": [\"q\", 1, \"q\", \"q\"] }"));
+        REQUIRE_THROWS_AS(clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest), pywrap::PyWrapException);
+        // The failed call left the GIL as it found it
+        clf.setHyperparameters(nlohmann::json::object());
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(clf.score(raw.Xt, raw.yt) == Catch::Approx(0.98).epsilon(raw.epsilon));
+    }
+}
+TEST_CASE("Conversion kernels", "[PyClassifiers]")
+{
+    // Wider than a tile in both directions, and a strided slice of it
+    auto source = torch::randint(0, 100, { 150, 301 }, torch::kInt32);
+    auto X = GENERATE_COPY(source, source.slice(1, 1, 300, 2), source.t().contiguous().t());
+    auto target = GENERATE(torch::kFloat32, torch::kFloat64, torch::kInt16);
+    auto destination = torch::empty({ X.size(1), X.size(0) }, target);
+    pywrap::transposeInto(X, target, destination.data_ptr());
+    REQUIRE(torch::equal(destination, X.t().to(target)));
+    auto narrow = torch::empty({ X.size(1), X.size(0) }, torch::kUInt8);
+    REQUIRE(pywrap::narrowInto(X, torch::kUInt8, narrow.data_ptr()));
+    REQUIRE(torch::equal(narrow, X.t().to(torch::kUInt8)));
+    // Out of the uint8 range, the caller keeps X as it is
+    auto wide = X.clone();
+    wide[7][200] = 256;
+    REQUIRE_FALSE(pywrap::narrowInto(wide, torch::kUInt8, narrow.data_ptr()));
+    wide[7][200] = -1;
+    REQUIRE_FALSE(pywrap::narrowInto(wide, torch::kUInt8, narrow.data_ptr()));
+}
+TEST_CASE("Converted input", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::SVC();
+    // Strided and float64 input reach SVC through the kernels, predictions don't change
+    auto wide = torch::cat({ raw.Xt, raw.Xt }, 1);
+    auto strided = wide.slice(1, 0, raw.nSamples);
+    clf.fit(strided, raw.yt);
+    REQUIRE(clf.score(strided, raw.yt) == Catch::Approx(0.96667f).epsilon(raw.epsilon));
+    auto Xd = raw.Xt.to(torch::kFloat64);
+    REQUIRE(torch::equal(clf.predict(Xd), clf.predict(raw.Xt)));
+    auto forest = pywrap::RandomForest();
+    forest.fit(Xd, raw.yt);
+    REQUIRE(forest.score(Xd, raw.yt) == Catch::Approx(1.0f).epsilon(raw.epsilon));
+}
+TEST_CASE("Conversion cache", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::SVC();
+    // int32 X is converted to float64 for SVC once and reused
+    clf.fit(raw.Xt, raw.yt);
+    auto score = clf.score(raw.Xt, raw.yt);
+    clf.predict(raw.Xt);
+    auto report = clf.conversionCacheReport();
+    REQUIRE(report["misses"] == 1);
+    REQUIRE(report["hits"] == 2);
+    REQUIRE(report["entries"] == 1);
+    // In place changes bump the version counter
+    raw.Xt.add_(1);
+    clf.score(raw.Xt, raw.yt);
+    REQUIRE(clf.conversionCacheReport()["misses"] == 2);
+    raw.Xt.sub_(1);
+    REQUIRE(clf.score(raw.Xt, raw.yt) == Catch::Approx(score).epsilon(raw.epsilon));
+    clf.setConversionCache(0);
+    REQUIRE(clf.conversionCacheReport()["entries"] == 0);
+}
+TEST_CASE("Single row predict", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto name = GENERATE("SVC", "XGBoost");
+    std::unique_ptr<pywrap::PyClassifier> clf;
+    if (std::string(name) == "SVC") {
+        clf = std::make_unique<pywrap::SVC>();
+    } else {
+        clf = std::make_unique<pywrap::XGBoost>();
+    }
+    REQUIRE_THROWS_AS(clf->predictRow(std::vector<double>(4).data()), std::runtime_error);
+    clf->fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto predictions = clf->predict(raw.Xt);
+    // [samples, features] so every row is contiguous
+    auto rowsd = raw.Xt.t().to(torch::kFloat64).contiguous();
+    auto rowsf = raw.Xt.t().to(torch::kFloat32).contiguous();
+    for (int i = 0; i < raw.nSamples; ++i) {
+        INFO(std::string("Classifier: ") + name + " Row: " + std::to_string(i));
+        REQUIRE(clf->predictRow(rowsd[i].data_ptr<double>()) == predictions[i].item<int>());
+        REQUIRE(clf->predictRow(rowsf[i].data_ptr<float>()) == predictions[i].item<int>());
+    }
+    // Row calls take turns over the model and its replicas
+    clf->replicate(2);
+    for (int i = 0; i < raw.nSamples; i += 10) {
+        REQUIRE(clf->predictRow(rowsd[i].data_ptr<double>()) == predictions[i].item<int>());
+    }
+}
+TEST_CASE("Numpy pool", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto wrap = pywrap::PyWrap::GetInstance();
+    wrap->setNumpyPool(true);
+    auto clf = pywrap::RandomForest();
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto predictions = clf.predict(raw.Xt);
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(torch::equal(clf.predict(raw.Xt), predictions));
+    }
+    auto metrics = wrap->metrics();
+    auto pool = metrics["numpy_pool"];
+    REQUIRE(pool["enabled"] == true);
+    REQUIRE(pool["allocations"].get<uint64_t>() > 0);
+    REQUIRE(pool["pool_hits"].get<uint64_t>() > 0);
+    REQUIRE(metrics["instances"].get<size_t>() >= 1);
+    wrap->setNumpyPool(false);
+    REQUIRE(wrap->metrics()["numpy_pool"]["enabled"] == false);
+}
+TEST_CASE("Garbage collector policy", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto wrap = pywrap::PyWrap::GetInstance();
+    auto policy = GENERATE(pywrap::GcPolicy::Freeze, pywrap::GcPolicy::Deferred, pywrap::GcPolicy::Disabled);
+    wrap->setGcPolicy(policy);
+    REQUIRE(wrap->getGcPolicy() == policy);
+    auto clf = pywrap::RandomForest();
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto predictions = clf.predict(raw.Xt);
+    REQUIRE(torch::equal(clf.predict(raw.Xt), predictions));
+    auto before = wrap->metrics()["gc"]["collections"][2].get<uint64_t>();
+    wrap->collectGarbage();
+    auto gc = wrap->metrics()["gc"];
+    REQUIRE(gc["collections"][2].get<uint64_t>() == before + 1);
+    REQUIRE(gc["pause_total_ms"].get<double>() > 0);
+    wrap->setGcPolicy(pywrap::GcPolicy::Default);
+    REQUIRE(wrap->metrics()["gc"]["policy"] == "default");
+}
+TEST_CASE("Interpreter startup", "[PyClassifiers]")
+{
+    auto wrap = pywrap::PyWrap::GetInstance();
+    // Other test cases already started the interpreter with the defaults
+    pywrap::InterpreterConfig config;
+    config.isolated = true;
+    config.preload = { "sklearn.ensemble" };
+    REQUIRE_THROWS_AS(pywrap::PyWrap::Initialize(config), pywrap::PyWrapException);
+    wrap->waitForPreload();
+    auto report = wrap->startupReport();
+    REQUIRE(report["interpreter_ms"].get<double>() > 0);
+    REQUIRE(report["isolated"] == false);
+    REQUIRE(report["preload"].empty());
+}
+TEST_CASE("Model metadata snapshot", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::RandomForest();
+    REQUIRE(clf.getNumberOfNodes() == 0);
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto metadata = clf.getMetadata();
+    REQUIRE(metadata["n_features"] == raw.featurest.size());
+    REQUIRE(metadata["classes"] == std::vector<int>({ 0, 1, 2 }));
+    REQUIRE(metadata["n_estimators"] == 10);
+    REQUIRE(metadata["estimators"].size() == 10);
+    // Same values the per estimator Python calls give
+    REQUIRE(clf.getNumberOfNodes() == clf.callMethodSumOfItems("node_count"));
+    REQUIRE(clf.getNumberOfEdges() == clf.callMethodSumOfItems("get_n_leaves"));
+    REQUIRE(clf.getNumberOfStates() == clf.callMethodSumOfItems("get_depth"));
+}
+TEST_CASE("Model replicas", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto mode = GENERATE(pywrap::CloneMode::DeepCopy, pywrap::CloneMode::Pickle, pywrap::CloneMode::SharedBuffers);
+    auto clf = pywrap::RandomForest();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+    clf.replicate(3, mode);
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE(clf.getReplicas() == 3);
+    auto expected = clf.predict(raw.Xt);
+    auto expectedVector = clf.predict(raw.Xv);
+    auto expectedProba = clf.predict_proba(raw.Xv);
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatches{ 0 };
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            auto Xv = raw.Xv;
+            for (int j = 0; j < 5; ++j) {
+                auto X = raw.Xt.clone();
+                if (!torch::equal(clf.predict(X), expected)) {
+                    mismatches++;
+                }
+                // The vector overloads lease a copy too
+                if (clf.predict(Xv) != expectedVector || clf.predict_proba(Xv) != expectedProba) {
+                    mismatches++;
+                }
+            }
+        });
+    }
+    // Rebuilt while the threads predict, every call keeps the copy it leased until it is done
+    for (int n : { 1, 3, 2 }) {
+        clf.replicate(n, mode);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    REQUIRE(mismatches == 0);
+    REQUIRE(clf.getReplicas() == 2);
+    clf.replicate(0);
+    REQUIRE(clf.getReplicas() == 0);
+    REQUIRE(torch::equal(clf.predict(raw.Xt), expected));
+}
+TEST_CASE("Deadline and cancellation", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::RandomForest();
+    // Thousands of trees, fitted one after another by the Python loop of the forest
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 20000, \"random_state\": 0 }"));
+    {
+        pywrap::CallLimits limits(std::chrono::milliseconds(100));
+        auto start = std::chrono::steady_clock::now();
+        REQUIRE_THROWS_AS(clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest), pywrap::PyDeadlineException);
+        REQUIRE(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+    }
+    // The stopped fit left an unfitted estimator with the same hyperparameters
+    REQUIRE_THROWS_AS(clf.predict(raw.Xt), pywrap::PyWrapException);
+    REQUIRE(clf.getMetadata().is_null());
+    pywrap::CancellationToken token;
+    std::thread canceller([&token]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        token.cancel();
+    });
+    {
+        pywrap::CallLimits limits(token);
+        REQUIRE_THROWS_AS(clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest), pywrap::PyCancelledException);
+    }
+    canceller.join();
+    // Already cancelled: the call doesn't even start
+    {
+        pywrap::CallLimits limits(token);
+        REQUIRE_THROWS_AS(clf.score(raw.Xt, raw.yt), pywrap::PyCancelledException);
+    }
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10 }"));
+    {
+        pywrap::CallLimits limits(std::chrono::minutes(1));
+        clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+        REQUIRE(clf.score(raw.Xt, raw.yt) > 0.9f);
+    }
+    // Every watched call shares the one watchdog thread
+    for (int i = 0; i < 50; ++i) {
+        pywrap::CallLimits limits(std::chrono::minutes(1));
+        clf.predict(raw.Xt);
+    }
+    auto watchdog = pywrap::PyWrap::GetInstance()->metrics()["watchdog"];
+    REQUIRE(watchdog["threads"] == 1);
+    REQUIRE(watchdog["watched"].get<int>() >= 50);
+    REQUIRE(watchdog["deadline_exceeded"].get<int>() >= 1);
+    REQUIRE(watchdog["cancelled"].get<int>() >= 1);
+    REQUIRE(watchdog["running"] == 0);
+}
+TEST_CASE("Native metrics", "[PyClassifiers]")
+{
+    auto y = torch::tensor(std::vector<int>({ 0, 0, 1, 1 }), torch::kInt32);
+    auto predictions = torch::tensor(std::vector<int>({ 0, 1, 1, 1 }), torch::kInt32);
+    auto probabilities = torch::tensor(std::vector<double>({ 0.9, 0.1, 0.6, 0.4, 0.65, 0.35, 0.2, 0.8 }), torch::kFloat64).reshape({ 4, 2 });
+    auto metrics = pywrap::computeMetrics({ "accuracy", "balanced_accuracy", "precision_macro", "recall_macro", "f1_macro", "f1_weighted", "confusion_matrix", "log_loss", "roc_auc" },
+        y, predictions, probabilities, { 0, 1 });
+    REQUIRE(metrics["accuracy"].get<double>() == Catch::Approx(0.75));
+    REQUIRE(metrics["balanced_accuracy"].get<double>() == Catch::Approx(0.75));
+    REQUIRE(metrics["precision_macro"].get<double>() == Catch::Approx((1.0 + 2.0 / 3.0) / 2));
+    REQUIRE(metrics["recall_macro"].get<double>() == Catch::Approx(0.75));
+    REQUIRE(metrics["f1_macro"].get<double>() == Catch::Approx((2.0 / 3.0 + 0.8) / 2));
+    REQUIRE(metrics["f1_weighted"].get<double>() == Catch::Approx((2.0 / 3.0 + 0.8) / 2));
+    REQUIRE(metrics["confusion_matrix"]["matrix"] == nlohmann::json::parse("[[1, 1], [0, 2]]"));
+    REQUIRE(metrics["log_loss"].get<double>() == Catch::Approx(0.472287).epsilon(1e-5));
+    REQUIRE(metrics["roc_auc"].get<double>() == Catch::Approx(0.75));
+    REQUIRE_THROWS_AS(pywrap::computeMetrics({ "unknown" }, y, predictions, probabilities, { 0, 1 }), std::invalid_argument);
+    // One prediction pass of a fitted model
+    auto raw = RawDatasets("iris", true);
+    auto clf = pywrap::RandomForest();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto evaluation = clf.evaluate(raw.Xt, raw.yt, { "accuracy", "f1_macro", "confusion_matrix", "log_loss", "roc_auc" });
+    REQUIRE(evaluation["accuracy"].get<double>() == Catch::Approx(clf.score(raw.Xt, raw.yt)));
+    REQUIRE(evaluation["confusion_matrix"]["labels"] == std::vector<int>({ 0, 1, 2 }));
+    REQUIRE(evaluation["f1_macro"].get<double>() > 0.9);
+    REQUIRE(evaluation["log_loss"].get<double>() > 0);
+    REQUIRE(evaluation["roc_auc"].get<double>() > 0.9);
+}
+TEST_CASE("Streaming predict", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto probabilities = GENERATE(false, true);
+    auto clf = pywrap::RandomForest();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+    clf.fit(raw.Xt, raw.yt);
+    auto expected = probabilities ? clf.predict_proba(raw.Xt) : clf.predict(raw.Xt);
+    std::vector<torch::Tensor> chunks;
+    pywrap::CallbackSink sink([&chunks](const torch::Tensor& chunk) { chunks.push_back(chunk); });
+    // 150 samples in chunks of 32: the last one is shorter
+    pywrap::TensorSource tensors(raw.Xt);
+    REQUIRE(clf.predictStream(tensors, sink, 32, probabilities) == raw.nSamples);
+    REQUIRE(chunks.size() == 5);
+    REQUIRE(torch::equal(torch::cat(chunks, 0), expected));
+    chunks.clear();
+    pywrap::ArffSource arff(pywrap::SourceData("Test").getPath() + "iris.arff");
+    REQUIRE(arff.getFeatures() == raw.featurest);
+    REQUIRE(clf.predictStream(arff, sink, 64, probabilities) == raw.nSamples);
+    REQUIRE(torch::equal(torch::cat(chunks, 0), expected));
+    // Errors of the source reach the caller
+    pywrap::CallbackSource failing(4, [](float*, int64_t) -> int64_t { throw std::runtime_error("source failed"); });
+    REQUIRE_THROWS_WITH(clf.predictStream(failing, sink), "source failed");
+    pywrap::CallbackSource narrow(3, [](float*, int64_t) -> int64_t { return 0; });
+    REQUIRE_THROWS_AS(clf.predictStream(narrow, sink), std::runtime_error);
+}
+TEST_CASE("Mapped dataset", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto path = (std::filesystem::temp_directory_path() / "pyclfs_iris.pyds").string();
+    // Small chunks, so the file is written in several appends
+    REQUIRE(pywrap::convertDataset(pywrap::SourceData("Test").getPath() + "iris.arff", path, torch::kFloat32, 64) == raw.nSamples);
+    {
+        pywrap::MappedDataset dataset(path);
+        REQUIRE(dataset.getFeatures() == raw.featurest);
+        REQUIRE(dataset.getClassName() == raw.classNamet);
+        REQUIRE(dataset.getSamples() == raw.nSamples);
+        REQUIRE(dataset.getStates().at(raw.classNamet) == std::vector<int>({ 0, 1, 2 }));
+        REQUIRE(torch::equal(dataset.getX(), raw.Xt));
+        REQUIRE(torch::equal(dataset.getY(), raw.yt));
+        // Sample major, the estimators read the pages as they are
+        REQUIRE(pywrap::isSampleMajor(dataset.getX()));
+        {
+            pywrap::PyGILGuard gil;
+            auto X = dataset.numpyX();
+            REQUIRE(X.shape(0) == raw.nSamples);
+            REQUIRE(X.shape(1) == static_cast<int64_t>(raw.featurest.size()));
+            REQUIRE(X.get_data() == dataset.getX().data_ptr());
+        }
+        auto clf = pywrap::RandomForest();
+        clf.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+        clf.fit(dataset.getX(), dataset.getY());
+        auto expected = pywrap::RandomForest();
+        expected.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+        expected.fit(raw.Xt, raw.yt);
+        REQUIRE(torch::equal(clf.predict(raw.Xt), expected.predict(raw.Xt)));
+    }
+    // Discretized data as uint8 with its states
+    auto discretized = RawDatasets("iris", true);
+    {
+        pywrap::DatasetWriter writer(path, discretized.featurest, discretized.classNamet, torch::kUInt8);
+        writer.append(discretized.Xt, discretized.yt);
+        writer.close(discretized.statest);
+    }
+    pywrap::MappedDataset dataset(path);
+    REQUIRE(dataset.getX().scalar_type() == torch::kUInt8);
+    REQUIRE(torch::equal(dataset.getX().to(torch::kInt32), discretized.Xt));
+    REQUIRE(dataset.getStates() == discretized.statest);
+    std::filesystem::remove(path);
+}
+TEST_CASE("Parallel loader", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto path = pywrap::SourceData("Test").getPath() + "iris.arff";
+    auto dataset = pywrap::loadDataFile(path);
+    REQUIRE(dataset.features == raw.featurest);
+    REQUIRE(dataset.className == raw.classNamet);
+    REQUIRE(dataset.states.at(raw.classNamet) == raw.statest.at(raw.classNamet));
+    REQUIRE(pywrap::isSampleMajor(dataset.X));
+    REQUIRE(torch::equal(dataset.X, raw.Xt));
+    REQUIRE(torch::equal(dataset.y, raw.yt));
+    pywrap::LoaderOptions featureMajor;
+    featureMajor.sampleMajor = false;
+    featureMajor.dtype = torch::kFloat64;
+    auto wide = pywrap::loadDataFile(path, featureMajor);
+    REQUIRE(wide.X.is_contiguous());
+    REQUIRE(torch::allclose(wide.X.to(torch::kFloat32), raw.Xt));
+    // Same bins as the fimdlp discretization of the test datasets
+    auto discretized = RawDatasets("iris", true);
+    pywrap::LoaderOptions mdlp;
+    mdlp.discretize = true;
+    auto discrete = pywrap::loadDataFile(path, mdlp);
+    REQUIRE(discrete.X.scalar_type() == torch::kInt32);
+    REQUIRE(pywrap::isSampleMajor(discrete.X));
+    REQUIRE(torch::equal(discrete.X, discretized.Xt));
+    for (const auto& feature : discrete.features) {
+        REQUIRE(discrete.states.at(feature).size() == discretized.statest.at(feature).size());
+    }
+    // CSV with a header, quoted class values numbered in order of appearance
+    auto csvPath = (std::filesystem::temp_directory_path() / "pyclfs_loader.csv").string();
+    {
+        std::ofstream csv(csvPath);
+        for (const auto& feature : raw.featurest) {
+            csv << feature << ",";
+        }
+        csv << raw.classNamet << "\n";
+        auto X = raw.Xt.t().contiguous();
+        for (int64_t sample = 0; sample < raw.nSamples; ++sample) {
+            for (int64_t feature = 0; feature < X.size(1); ++feature) {
+                csv << std::setprecision(9) << X[sample][feature].item<float>() << ",";
+            }
+            csv << "'class " << raw.yt[sample].item<int>() << "'\n";
+        }
+    }
+    auto fromCsv = pywrap::loadDataFile(csvPath);
+    std::filesystem::remove(csvPath);
+    REQUIRE(fromCsv.features == raw.featurest);
+    REQUIRE(torch::equal(fromCsv.X, raw.Xt));
+    // Codes follow the first appearance of every class
+    std::map<int, int> codes;
+    std::vector<int> expected;
+    for (int64_t sample = 0; sample < raw.nSamples; ++sample) {
+        auto label = raw.yt[sample].item<int>();
+        expected.push_back(codes.emplace(label, static_cast<int>(codes.size())).first->second);
+    }
+    REQUIRE(torch::equal(fromCsv.y, torch::tensor(expected, torch::kInt32)));
+    REQUIRE(fromCsv.states.at(raw.classNamet).size() == codes.size());
+    // What fit takes as it is
+    auto clf = pywrap::STree();
+    clf.fit(dataset.X, dataset.y, dataset.features, dataset.className, dataset.states);
+    REQUIRE(clf.score(dataset.X, dataset.y) > 0.5f);
+}
+TEST_CASE("Fused preprocessing", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    // Standard scaling as sklearn's StandardScaler computes it
+    auto scaler = pywrap::Preprocessing().standardize();
+    scaler.fit(raw.Xt, raw.yt);
+    auto Xd = raw.Xt.to(torch::kFloat64);
+    auto expected = (Xd - Xd.mean(1, true)) / Xd.std(1, false, true);
+    auto scaled = scaler.transform(raw.Xt, torch::kFloat64);
+    REQUIRE(pywrap::isSampleMajor(scaled));
+    REQUIRE(torch::allclose(scaled, expected));
+    // MDLP edges give back the fimdlp bins of the training data
+    auto discretized = RawDatasets("iris", true);
+    auto mdlp = pywrap::Preprocessing().discretize();
+    mdlp.fit(raw.Xt, raw.yt);
+    REQUIRE(torch::equal(mdlp.transform(raw.Xt, torch::kInt32), discretized.Xt));
+    // Selection and min-max, restored from its json
+    auto selected = pywrap::Preprocessing().select({ 3, 1 }).minMax(-1.0, 1.0);
+    selected.fit(raw.Xt, raw.yt);
+    REQUIRE(selected.outputFeatures() == 2);
+    auto ranged = selected.transform(raw.Xt);
+    REQUIRE(ranged.min().item<float>() == Catch::Approx(-1.0f));
+    REQUIRE(ranged.max().item<float>() == Catch::Approx(1.0f));
+    auto restored = pywrap::Preprocessing(selected.toJson());
+    REQUIRE(restored.isFitted());
+    REQUIRE(torch::equal(restored.transform(raw.Xt), ranged));
+    // Declared as a hyperparameter: the estimator sees what the pipeline gives
+    auto clf = pywrap::SVC();
+    clf.setHyperparameters(nlohmann::json::parse("{ \"C\": 1.0, \"preprocessing\": [ { \"step\": \"standard\" } ] }"));
+    clf.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE(clf.getMetadata().at("preprocessing").at("steps")[0].contains("mean"));
+    auto reference = pywrap::SVC();
+    reference.setHyperparameters(nlohmann::json::parse("{ \"C\": 1.0 }"));
+    reference.fit(scaled, raw.yt);
+    auto predictions = clf.predict(raw.Xt);
+    REQUIRE(torch::equal(predictions, reference.predict(scaled)));
+    // The row path and the stream go through the pipeline as well
+    auto row = raw.Xt.select(1, 10).contiguous();
+    REQUIRE(clf.predictRow(row.data_ptr<float>()) == predictions[10].item<int>());
+    pywrap::TensorSource source(raw.Xt);
+    std::vector<torch::Tensor> chunks;
+    pywrap::CallbackSink sink([&chunks](const torch::Tensor& chunk) { chunks.push_back(chunk.clone()); });
+    REQUIRE(clf.predictStream(source, sink, 64) == raw.nSamples);
+    REQUIRE(torch::equal(torch::cat(chunks).to(torch::kInt32), predictions));
+}
+TEST_CASE("Extend fitted models", "[PyClassifiers]")
+{
+    auto raw = RawDatasets("iris", false);
+    auto forest = pywrap::RandomForest();
+    forest.setHyperparameters(nlohmann::json::parse("{ \"n_estimators\": 10, \"random_state\": 0 }"));
+    REQUIRE_THROWS_AS(forest.extend(raw.Xt, raw.yt, 5), std::runtime_error);
+    forest.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto trees = forest.getMetadata().at("estimators");
+    forest.extend(raw.Xt, raw.yt, 5);
+    REQUIRE(forest.getMetadata().at("n_estimators") == 15);
+    // The trees it had are kept as they were
+    auto grown = forest.getMetadata().at("estimators");
+    REQUIRE(std::equal(trees.begin(), trees.end(), grown.begin()));
+    REQUIRE(forest.score(raw.Xt, raw.yt) > 0.9f);
+    // A refit starts from zero with the grown size
+    forest.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE(forest.getMetadata().at("n_estimators") == 15);
+    auto boosted = pywrap::XGBoost();
+    boosted.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    auto rounds = boosted.getMetadata().at("n_estimators").get<int>();
+    boosted.extend(raw.Xt, raw.yt, 10);
+    REQUIRE(boosted.getMetadata().at("n_estimators") == rounds + 10);
+    REQUIRE(boosted.score(raw.Xt, raw.yt) > 0.9f);
+    auto stree = pywrap::STree();
+    stree.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE_THROWS_AS(stree.extend(raw.Xt, raw.yt, 5), pywrap::PyUnsupportedException);
+    auto svc = pywrap::SVC();
+    svc.fit(raw.Xt, raw.yt, raw.featurest, raw.classNamet, raw.statest);
+    REQUIRE_THROWS_AS(svc.extend(raw.Xt, raw.yt, 5), pywrap::PyUnsupportedException);
+}